@@ -0,0 +1,219 @@
+// Checks the coverage blending against the float CastToColor() it replaced:
+// every coverage, color and destination channel value goes through
+// BlendCoverage() and through each span kernel the cpu has.
+//
+// BlendCoverage() has to be the rounded ( c * a + ( 255 - c ) * b ) / 255
+// exactly and the kernels have to give the same pixels as it does. The old
+// float function truncated instead of rounding, it is allowed to be one off.
+//
+// Both blends are also hashed over the same inputs and compared to the hash
+// they had when they were written, so a kernel change that moves even one
+// pixel shows up here, formula or not.
+//
+// Returns 0 when everything matches. The check_blend project runs it after
+// every build, elsewhere it builds on its own like the other mains do.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "utils/color/ccolor.cpp"
+#include "utils/color/cblend.cpp"
+
+typedef ceng::uint32 Uint32;
+
+// what CastToColor() was before the integer blend
+Uint32 CastToColorFloat( Uint32 c1, Uint32 c2, unsigned char how_much_of_1 )
+{
+	if( c1 == c2 ) return c1;
+	float how_much = (float)(how_much_of_1) / 255.f;
+
+	types::fcolor color1( c1 );
+	types::fcolor color2( c2 );
+
+	types::fcolor result = how_much * color1 + ( 1.f - how_much ) * color2;
+
+	std::swap( result.r, result.a );
+	return result.Get32();
+}
+
+// the formula, one channel at a time
+Uint32 BlendExact( Uint32 c1, Uint32 c2, unsigned char how_much_of_1 )
+{
+	if( c1 == c2 ) return c1;
+
+	const Uint32 c = how_much_of_1;
+	Uint32 result = 0;
+	for( int shift = 0; shift < 32; shift += 8 )
+	{
+		const Uint32 a = ( c1 >> shift ) & 0xFF;
+		const Uint32 b = ( c2 >> shift ) & 0xFF;
+		result |= ( ( a * c + b * ( 255 - c ) + 127 ) / 255 ) << shift;
+	}
+
+	return ceng::SwapRedAndAlpha< ceng::PixelNative >( result );
+}
+
+// every channel gets a different value out of v, but all of them go
+// through [0, 255] as v does
+Uint32 MakeColor( int v )
+{
+	return (Uint32)v | (Uint32)( 255 - v ) << 8 | (Uint32)( v ^ 0x5A ) << 16 | (Uint32)( ( v * 7 ) & 0xFF ) << 24;
+}
+
+Uint32 MakeDest( int v )
+{
+	return (Uint32)( ( v * 7 ) & 0xFF ) | (Uint32)( v ^ 0x5A ) << 8 | (Uint32)( 255 - v ) << 16 | (Uint32)v << 24;
+}
+
+int ChannelDifference( Uint32 x, Uint32 y )
+{
+	int result = 0;
+	for( int shift = 0; shift < 32; shift += 8 )
+		result = std::max( result, std::abs( (int)( ( x >> shift ) & 0xFF ) - (int)( ( y >> shift ) & 0xFF ) ) );
+	return result;
+}
+
+int CheckBlendCoverage()
+{
+	int errors = 0;
+	int float_max_difference = 0;
+	long float_differences = 0;
+
+	for( int c = 0; c < 256; ++c )
+	{
+		for( int a = 0; a < 256; ++a )
+		{
+			const Uint32 color = MakeColor( a );
+			for( int b = 0; b < 256; ++b )
+			{
+				// a == b is the color == dest case for both
+				const Uint32 dest = ( a == b ) ? color : MakeDest( b );
+				const Uint32 result = ceng::BlendCoverage( color, dest, (unsigned char)c );
+
+				if( result != BlendExact( color, dest, (unsigned char)c ) )
+				{
+					if( errors++ < 10 )
+						printf( "BlendCoverage( %08X, %08X, %d ) = %08X, should be %08X\n", color, dest, c, result, BlendExact( color, dest, (unsigned char)c ) );
+				}
+
+				const int difference = ChannelDifference( result, CastToColorFloat( color, dest, (unsigned char)c ) );
+				if( difference > 0 )
+					++float_differences;
+				float_max_difference = std::max( float_max_difference, difference );
+			}
+		}
+	}
+
+	if( float_max_difference > 1 )
+	{
+		printf( "BlendCoverage() is %d off the float CastToColor()\n", float_max_difference );
+		++errors;
+	}
+
+	printf( "BlendCoverage: %d mismatches, %ld of %d pixels one off the float version\n", errors, float_differences, 256 * 256 * 256 );
+	return errors;
+}
+
+typedef unsigned int ( *BlendFunction )( unsigned int, unsigned int, unsigned char );
+
+// FNV-1a over every result of blend for the inputs CheckBlendCoverage() uses
+unsigned long long HashBlend( BlendFunction blend )
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for( int c = 0; c < 256; ++c )
+	{
+		for( int a = 0; a < 256; ++a )
+		{
+			const Uint32 color = MakeColor( a );
+			for( int b = 0; b < 256; ++b )
+			{
+				const Uint32 dest = ( a == b ) ? color : MakeDest( b );
+				const Uint32 result = blend( color, dest, (unsigned char)c );
+				for( int shift = 0; shift < 32; shift += 8 )
+				{
+					hash ^= ( result >> shift ) & 0xFF;
+					hash *= 1099511628211ULL;
+				}
+			}
+		}
+	}
+	return hash;
+}
+
+int CheckReference( const char* name, BlendFunction blend, unsigned long long reference )
+{
+	const unsigned long long hash = HashBlend( blend );
+	if( hash != reference )
+	{
+		printf( "%s: hash %016llX, should be %016llX\n", name, hash, reference );
+		return 1;
+	}
+
+	printf( "%s: matches the reference\n", name );
+	return 0;
+}
+
+int CheckSpanKernel( const char* name )
+{
+	if( ceng::SetBlendKernel( name ) == false )
+	{
+		printf( "%s: not available, skipped\n", name );
+		return 0;
+	}
+
+	// a few pixels past 256 for the scalar tail, and one in front so the
+	// loads aren't aligned
+	const int count = 259;
+	std::vector< Uint32 > buffer( count + 1 );
+	std::vector< unsigned char > coverage( count );
+	Uint32* dest = &buffer[ 1 ];
+
+	int errors = 0;
+	for( int a = 0; a < 256; ++a )
+	{
+		const Uint32 color = MakeColor( a );
+
+		// pixel i is destination i & 255, over all c it meets every coverage
+		// once. Zero coverage ends up in the middle of the vectors too
+		for( int c = 0; c < 256; ++c )
+		{
+			for( int i = 0; i < count; ++i )
+			{
+				dest[ i ] = ( ( i & 0xFF ) == a ) ? color : MakeDest( i & 0xFF );
+				coverage[ i ] = (unsigned char)( ( c + i * 37 ) & 0xFF );
+			}
+
+			ceng::BlendCoverageSpan( dest, &coverage[ 0 ], count, color );
+
+			for( int i = 0; i < count; ++i )
+			{
+				const Uint32 before = ( ( i & 0xFF ) == a ) ? color : MakeDest( i & 0xFF );
+				const Uint32 expected = coverage[ i ] ? ceng::BlendCoverage( color, before, coverage[ i ] ) : before;
+				if( dest[ i ] != expected )
+				{
+					if( errors++ < 10 )
+						printf( "%s: color %08X over %08X at %d is %08X, should be %08X\n", name, color, before, coverage[ i ], dest[ i ], expected );
+				}
+			}
+		}
+	}
+
+	printf( "%s: %d mismatches\n", name, errors );
+	return errors;
+}
+
+int main( int argc, char** args )
+{
+	ceng::SetBlendSpace( ceng::BLEND_GAMMA );
+
+	int errors = CheckBlendCoverage();
+	errors += CheckReference( "BlendCoverage", ceng::BlendCoverage, 0x1E2592BB6E37B73DULL );
+	errors += CheckReference( "BlendCoverageLinear", ceng::BlendCoverageLinear, 0x5CCD463E8AF781FEULL );
+	errors += CheckSpanKernel( "scalar" );
+	errors += CheckSpanKernel( "sse2" );
+	errors += CheckSpanKernel( "avx2" );
+
+	return errors == 0 ? 0 : 1;
+}
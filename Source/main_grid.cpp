@@ -1,60 +1,96 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 #include <vector>
 #include <iostream>
 #include <fstream>
 
-namespace types
-{
-	struct rect
-	{
-		rect() : x(0),y(0),w(0),h(0) { }
-		rect( float x, float y, float w, float h ) : x(x), y(y), w(w), h(h) { }
-		float x, y, w, h;
-	};
-}
 #include "utils/array2d/carray2d.h"
+#include "utils/array2d/carray2dview.h"
 #include "utils/math/cvector2.h"
+#include "utils/math/crect.h"
 #include "utils/color/ccolor.cpp"
+#include "utils/color/cblend.cpp"
+#include "utils/memory/carena.cpp"
+
+typedef ceng::uint32 Uint32;
 
 // #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb/stb_image_write.h"
+#include "utils/image/cpngencoder.cpp"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb/stb_truetype.h"
 
+#include "utils/filesystem/cmappedfile.cpp"
+#include "utils/font/cfont.cpp"
+#include "utils/font/csdffont.cpp"
+#include "utils/font/cfontregistry.cpp"
+#include "utils/font/ctextrun.cpp"
+#include "utils/render/cdrawlist.cpp"
 
-void SaveImage( const std::string& filename, const ceng::CArray2D< unsigned int >& image_data )
+
+// the png writer's buffers, and a staging copy if one is needed, come from
+// arena when there is one. Pages can't be saved on two threads at once,
+// see ceng::EncodePNG()
+void SaveImage( const std::string& filename, const ceng::CArray2DView< const Uint32 >& image_data, ceng::CArena* arena = NULL )
 {
 	// do the file and save it
 	const int w = image_data.GetWidth();
 	const int h = image_data.GetHeight();
-	
-	unsigned char* pixels = NULL;
-	pixels = new unsigned char[ 4 * w * h ];	
 
-	ceng::CColorUint8 c;
-	for( int y = 0; y < h; ++y )
+	// stb_image_write works its buffer sizes out in int, ( 4 * w + 1 ) * h
+	// bytes has to fit or the png comes out garbled
+	if( w > ( INT_MAX - 1 ) / 4 || ( h > 0 && 4 * w + 1 > INT_MAX / h ) )
 	{
-		for( int x = 0; x < w; ++x )
-		{
-			c.Set32( image_data.Rand( x, y ) );
+		std::cout << "SaveImage - image too large to save as png: " << filename << " (" << w << " x " << h << ")" << std::endl;
+		return;
+	}
 
-			int p = ( 4 * x + 4 * w * y);
-			pixels[ p + 0 ] = c.GetR();
-			pixels[ p + 1 ] = c.GetG();
-			pixels[ p + 2 ] = c.GetB();
-			pixels[ p + 3 ] = c.GetA();
+	// the png wants R, G, B, A bytes, if that's what the pixels are already
+	// they are written from where they are
+	const void* png_pixels = image_data.GetData();
+	int png_stride = image_data.GetStride() * 4;
+
+	ceng::CSafeArray< unsigned char > pixels;
+	if( ceng::CSameFormat< ceng::PixelNative, ceng::PixelRGBA8 >::value == false )
+	{
+		pixels.SetArena( arena );
+		pixels.ResizeUninitialized( (ptrdiff_t)4 * w * h );
+
+		for( int y = 0; y < h; ++y )
+		{
+			ceng::ConvertRow< ceng::PixelNative, ceng::PixelRGBA8 >( image_data.Row( y ), pixels.data + (size_t)4 * w * y, w );
 		}
+
+		png_pixels = pixels.data;
+		png_stride = w * 4;
 	}
 
-	stbi_write_png( filename.c_str(), w, h, 4, pixels, w * 4 );
-	// poro::IPlatform::Instance()->GetGraphics()->ImageSave( filename.c_str(), w, h, 4, pixels, w * 4 );
+	// encoded in memory and written with one unbuffered fwrite, so stdio
+	// doesn't allocate a buffer of its own for every page
+	int png_size = 0;
+	unsigned char* png = ceng::EncodePNG( (const unsigned char*)png_pixels, png_stride, w, h, png_size, arena );
+
+	bool ok = false;
+	FILE* file = png ? fopen( filename.c_str(), "wb" ) : NULL;
+	if( file )
+	{
+		setvbuf( file, NULL, _IONBF, 0 );
+		ok = fwrite( png, 1, png_size, file ) == (size_t)png_size;
+		if( fclose( file ) != 0 )
+			ok = false;
+	}
 
-	delete [] pixels;
-	pixels = NULL;
+	ceng::FreePNG( png, arena );
+
+	if( ok == false )
+		std::cout << "SaveImage - Couldn't write file: " << filename << std::endl;
+
+	// poro::IPlatform::Instance()->GetGraphics()->ImageSave( filename.c_str(), w, h, 4, pixels, w * 4 );
 }
 
 
@@ -65,6 +101,13 @@ struct GridParams
 	int n;		// number of elements
 	std::string font;
 	float font_size;
+	std::string font_cache_dir;	// baked fonts are cached here, empty disables the cache
+	bool font_auto_fit;			// PrintAGrid picks the largest size up to font_size that fits each cell
+	float font_min_size;		// auto fit never goes below this
+	bool font_sdf;				// draw from one distance field atlas instead of a bitmap font per size
+	bool linear_blend;			// blend anti-aliased edges in linear light instead of on the sRGB values
+	bool deferred;				// record the page and render it a band of rows at a time. Only
+								// the order the page is written in changes, nothing is kept
 	Uint32 background_color;
 	Uint32 foreground_color;
 	int border_size;
@@ -72,99 +115,34 @@ struct GridParams
 
 
 
-struct CharQuad
-{
-	CharQuad() : rect(), offset(), width( 0 ) { }
-	CharQuad( const types::rect& rect, const types::vector2& offset, float width ) : rect( rect ), offset( offset ), width( width ) { }
-
-	types::rect			rect;
-	types::vector2		offset;
-	float				width;
-	float				height;
-	
-};
-
-unsigned char ttf_buffer[1<<25];
-
-const int bitmap_width = 4096;
-const int bitmap_height = 20480;
+ceng::CFontRegistry font_registry;
+ceng::CTextRunCache text_run_cache;
 
-unsigned char bmap[ bitmap_width * bitmap_height ];
-std::vector< CharQuad > char_quads;
+// deferred pages are recorded into this. It's emptied once the page is
+// rendered, the command storage stays for the next page
+ceng::CDrawList page_draw_list;
 	
-void CreateFont(
+ceng::CFont* CreateFont(
 	const std::string& ttf_file,
-	float size )
+	float size,
+	const std::string& cache_dir )
 {
-	memset( bmap, 0, bitmap_width*bitmap_height );
-	memset( ttf_buffer, 0, 1 << 25 );
-	FILE* fptr = fopen(ttf_file.c_str(), "rb");
+	font_registry.SetCacheDir( cache_dir );
 
-	if( fptr == NULL ) 
-	{
+	ceng::CFont* font = font_registry.GetFont( ttf_file, size );
+	if( font == NULL )
 		std::cout << "Error reading file: " << ttf_file << std::endl;
-		return;
-	}
-
-	fread(ttf_buffer, 1, 1<<25, fptr);
-
-	stbtt_bakedchar g_cdata[95]; // ASCII 32..126 is 95 glyphs
-	stbtt_BakeFontBitmap( ttf_buffer, 0, size, bmap, bitmap_width, bitmap_height, 32, 95, g_cdata);
-
-	int tsize_x = 0;
-	int tsize_y = 0;
-
-	if( char_quads.size() < 95 + 32 )
-		char_quads.resize( 95 + 32 );
 
-	for( int i = 0; i < 95; ++i ) 
-	{
-		char_quads[ i + 32 ] = CharQuad(
-				types::rect( 
-					(float)g_cdata[ i ].x0, 
-					(float)g_cdata[ i ].y0,
-					(float)(g_cdata[ i ].x1 - g_cdata[ i ].x0),
-					(float)(g_cdata[ i ].y1 - g_cdata[ i ].y0) ),
-				types::vector2( 
-					g_cdata[ i ].xoff, 
-					g_cdata[ i ].yoff ),
-				g_cdata[ i ].xadvance );
-		
-		char_quads[ i + 32 ].height = size;
-
-		if( g_cdata[ i ].x1 > tsize_x ) tsize_x = g_cdata[ i ].x1;
-		if( g_cdata[ i ].y1 > tsize_y ) tsize_y = g_cdata[ i ].y1;
-	}
-
-	// int result = poro::ImageSave( icon_file.c_str(), w, h, 3, pixels, w * 3 );
-
-	/*tsize_x += 1;
-	tsize_y += 1;
-
-	// convert this into a 32bit image
-	unsigned char* pixels = (unsigned char*)malloc(width*height*4);
+	return font;
+}
 
-	for( int y = 0; y < tsize_y; ++y )
-	{
-		for( int x = 0; x < tsize_x; ++x )
-		{
-			int p = ( 4 * x + 4 * tsize_x * y);
-			// int p2 = (x + (pos_x * 3)) + ( 3 * width * ( y + pos_y));
-			// int p1 = ( x + w * y )
-			pixels[ p + 0 ] = 255;
-			pixels[ p + 1 ] = 255;
-			pixels[ p + 2 ] = 255;
-			pixels[ p + 3 ] = bmap[ x + width * y ];
-		}
-	}
+ceng::CSDFFont* CreateSDFFont( const std::string& ttf_file )
+{
+	ceng::CSDFFont* font = font_registry.GetSDFFont( ttf_file );
+	if( font == NULL )
+		std::cout << "Error reading file: " << ttf_file << std::endl;
 
-	std::cout << "Creating file: " << texture_file << " ... ";
-	stbi_write_png( texture_file.c_str(), tsize_x, tsize_y, 4, pixels, tsize_x * 4 );
-	std::cout << "Done" << std::endl;
-	
-	std::cout << "Creating file: " << xml_filename << " ... ";
-	ceng::XmlSaveToFile( *font, xml_filename, "Font" );
-	std::cout << "Done" << std::endl;*/
+	return font;
 }
 
 // -- reading CSV files --
@@ -298,123 +276,152 @@ void LoadCSVFile( const std::string& csv_file, ceng::CArray2D< std::string >& re
 }
 
 
-void BlitImage( ceng::CArray2D< Uint32 >& blit_this, ceng::CArray2D< Uint32 >& to_here, int pos_x, int pos_y )
+void FillRect( const ceng::CArray2DView< Uint32 >& to_here, int pos_x, int pos_y, int w, int h, Uint32 color )
 {
-	for( int y = 0; y < blit_this.GetHeight(); ++y )
+	const int x0 = std::max( 0, pos_x );
+	const int y0 = std::max( 0, pos_y );
+	const int x1 = std::min( to_here.GetWidth(), pos_x + w );
+	const int y1 = std::min( to_here.GetHeight(), pos_y + h );
+	if( x1 <= x0 )
+		return;
+
+	for( int y = y0; y < y1; ++y )
 	{
-		for( int x = 0; x < blit_this.GetWidth(); ++x )
-		{
-			if( to_here.IsValid( x + pos_x, y + pos_y ) )
-			{
-				to_here.At( x + pos_x, y + pos_y ) = blit_this.At( x, y );
-			}
-		}
+		Uint32* row = to_here.Row( y );
+		std::fill( row + x0, row + x1, color );
 	}
 }
 
-Uint32 CastToColor( Uint32 c1, Uint32 c2, unsigned char how_much_of_1 )
+// outline thickness pixels wide drawn inside the rectangle
+void StrokeRect( const ceng::CArray2DView< Uint32 >& to_here, int pos_x, int pos_y, int w, int h, int thickness, Uint32 color )
 {
-	if( c1 == c2 ) return c1;
-	float how_much = (float)(how_much_of_1) / 255.f;
-
-	/*
-	unsigned int c = 255 - how_much_of_1;
-	types::fcolor color1;
-	color1.Set8( c, c, c, 255 );
-	return color1.Get32();*/
+	const int top = std::min( thickness, h );
+	const int bottom = std::max( top, h - thickness );
+	const int left = std::min( thickness, w );
+	const int right = std::max( left, w - thickness );
+
+	FillRect( to_here, pos_x, pos_y, w, top, color );
+	FillRect( to_here, pos_x, pos_y + bottom, w, h - bottom, color );
+	FillRect( to_here, pos_x, pos_y + top, left, bottom - top, color );
+	FillRect( to_here, pos_x + right, pos_y + top, w - right, bottom - top, color );
+}
 
-	types::fcolor color1( c1 );
-	types::fcolor color2( c2 );
+// records into draw_list instead of drawing if there is one
+void BlitTextRun( const ceng::CTextRun* run, const ceng::CArray2DView< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor, ceng::CDrawList* draw_list = NULL )
+{
+	if( run == NULL )
+		return;
 
-	types::fcolor result = how_much * color1 + ( 1.f - how_much ) * color2;
+	int pos_x = (int)( center_x - 0.5f * run->width + 0.5f); 
+	int pos_y = (int)( center_y + 0.5f * run->height + 0.5f ); 
 
-	std::swap( result.r, result.a );
-	// result.SetR( ( color1.GetR() > color2.GetR() )? color1.GetR() : color2.GetR() );
-	return result.Get32();
-}
+	int px = pos_x + run->left;
+	int py = pos_y + run->top;
 
-void BlitText( const std::string& text, ceng::CArray2D< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor )
-{
-	float width = 0;
-	float height = 0;
-	for( std::size_t i = 0; i < text.size(); ++i ) 
+	if( draw_list )
 	{
-		char c = text[i];
-		if( c > char_quads.size() ) continue;
-		width += char_quads[ c ].width;
-		height = std::max( char_quads[ c ].rect.h, height );
+		draw_list->BlitText( run, px, py, fcolor );
+		return;
 	}
-	
-	int pos_x = (int)( center_x - 0.5f * width + 0.5f); 
-	int pos_y = (int)( center_y + 0.5f * height + 0.5f ); 
-	
-	for( std::size_t i = 0; i < text.size(); ++i ) 
+
+	// only the non-zero spans get touched, clipped against the image
+	for( std::size_t i = 0; i < run->spans.size(); ++i )
 	{
-		char c = text[i];
-		if( c > char_quads.size() ) continue;
+		const ceng::CCoverageSpan& span = run->spans[ i ];
+		const int y = py + span.y;
+		if( y < 0 || y >= to_here.GetHeight() ) 
+			continue;
+
+		const int x0 = std::max( span.x, -px );
+		const int x1 = std::min( span.x + span.length, to_here.GetWidth() - px );
+		if( x1 <= x0 ) 
+			continue;
+
+		Uint32* row = to_here.Row( y ) + px + x0;
+		if( span.opaque )
+			ceng::FillCoverageSpan( row, x1 - x0, fcolor );
+		else
+			ceng::BlendCoverageSpan( row, run->coverage.Row( span.y ) + x0, x1 - x0, fcolor );
+	}
+}
 
-		int px =(int)( pos_x + char_quads[c].offset.x );
-		int py =(int)( pos_y + char_quads[c].offset.y );
+void BlitText( ceng::CFont* font, const std::string& text, const ceng::CArray2DView< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor, ceng::CDrawList* draw_list = NULL )
+{
+	BlitTextRun( text_run_cache.GetRun( font, text ), to_here, center_x, center_y, fcolor, draw_list );
+}
 
-		for( int y = 0; y < char_quads[c].rect.h; ++y )
-		{
-			for( int x = 0; x < char_quads[c].rect.w; ++x )
-			{
-				int bitx = x + char_quads[c].rect.x;
-				int bity = y + char_quads[c].rect.y;
-			
-				unsigned char color = bmap[ bitx + bitmap_width * bity ];
-				// if( color > 0 )
-				{
-					to_here.At( px + x, py + y ) = CastToColor( fcolor, to_here.At( px + x, py + y ), color );
-				}
-			
-			}
-		}
+void BlitText( ceng::CSDFFont* font, float size, const std::string& text, const ceng::CArray2DView< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor, ceng::CDrawList* draw_list = NULL )
+{
+	BlitTextRun( text_run_cache.GetRun( font, size, text ), to_here, center_x, center_y, fcolor, draw_list );
+}
 
-		pos_x += char_quads[c].width;
+// outline in the foreground color, inside in the background color
+void DrawCell( const ceng::CArray2DView< Uint32 >& image, int pos_x, int pos_y, int w, int h, const GridParams& params, ceng::CDrawList* draw_list )
+{
+	const int border = params.border_size;
+	if( draw_list )
+	{
+		draw_list->StrokeRect( pos_x, pos_y, w, h, border, params.foreground_color );
+		draw_list->FillRect( pos_x + border, pos_y + border, w - 2 * border, h - 2 * border, params.background_color );
+	}
+	else
+	{
+		StrokeRect( image, pos_x, pos_y, w, h, border, params.foreground_color );
+		FillRect( image, pos_x + border, pos_y + border, w - 2 * border, h - 2 * border, params.background_color );
 	}
 }
 
-void DoAGrid( const GridParams& params, const std::string& output_filename )
+// page_arena holds the render and save temporaries, it's reset once the
+// page is saved. Callers drawing many pages keep one for all of them, the
+// memory is then already there for the next page. NULL uses the heap
+void DoAGrid( const GridParams& params, const std::string& output_filename, ceng::CArena* page_arena = NULL )
 {
-	ceng::CArray2D< Uint32 > image( params.image_w, params.image_h );
+	// the page itself is in page_arena too, and goes with the Reset()
+	ceng::CArray2D< Uint32 > image;
+	image.SetArena( page_arena );
+	image.ResizeUninitialized( params.image_w, params.image_h );
 	image.SetEverythingTo( params.background_color );
-	CreateFont( params.font, params.font_size );
+	ceng::SetBlendSpace( params.linear_blend ? ceng::BLEND_LINEAR : ceng::BLEND_GAMMA );
+	ceng::CFont* font = NULL;
+	ceng::CSDFFont* sdf_font = NULL;
+	if( params.font_sdf )
+		sdf_font = CreateSDFFont( params.font );
+	else
+		font = CreateFont( params.font, params.font_size, params.font_cache_dir );
 
 	// SaveImage( output_filename, image );
 
+	// the runs recorded into the draw list have to stay in the cache until
+	// it's rendered
+	ceng::CDrawList* draw_list = params.deferred ? &page_draw_list : NULL;
+	if( draw_list )
+		text_run_cache.Pin();
+
 	float square_size = (float)( params.image_w * 2 + params.image_h * 2 ) / (float)( params.n + 4 );
-	ceng::CArray2D< Uint32 > border( (int)(square_size + 0.5f), (int)(square_size + 0.5f) );
-	
-	for( int y = 0; y < border.GetHeight(); ++y )
-	{
-		for( int x = 0; x < border.GetWidth(); ++x )
-		{
-			Uint32 c = params.foreground_color;		
-			if( x >= params.border_size && x < border.GetWidth() - params.border_size &&
-				y >= params.border_size && y < border.GetHeight() - params.border_size )
-			{
-				c = params.background_color;
-			}
-			border.At( x, y ) = c;
-		}
-	}
+	const int cell_w = (int)(square_size + 0.5f);
+	const int cell_h = (int)(square_size + 0.5f);
 
 	{
 		types::ivector2 pos( 0, 0 );
 		types::ivector2 vel( 1, 0 );
-		int x_width = params.image_w / border.GetWidth();
-		int y_height = params.image_h / border.GetHeight();
+		int x_width = params.image_w / cell_w;
+		int y_height = params.image_h / cell_h;
 		int n = x_width;
+		std::string label;
 		for( int i = 0; i < params.n - 1; ++i )
 		{
-			BlitImage( border, image, pos.x, pos.y );
-			std::stringstream ss;
-			ss << ( i);
-			BlitText( ss.str(), image, pos.x + border.GetWidth() / 2, pos.y + border.GetHeight() / 2, params.foreground_color );
-
-			types::ivector2 actual_vel = types::ivector2( vel.x * border.GetWidth(), vel.y * border.GetHeight() );
+			DrawCell( image, pos.x, pos.y, cell_w, cell_h, params, draw_list );
+
+			// short enough to stay in the string itself, no stream per label
+			char number[ 16 ];
+			sprintf( number, "%d", i );
+			label.assign( number );
+			if( sdf_font )
+				BlitText( sdf_font, params.font_size, label, image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
+			else
+				BlitText( font, label, image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
+
+			types::ivector2 actual_vel = types::ivector2( vel.x * cell_w, vel.y * cell_h );
 			types::ivector2 new_pos = pos + actual_vel;
 			n--;
 			if( n <= 0 )
@@ -431,7 +438,7 @@ void DoAGrid( const GridParams& params, const std::string& output_filename )
 				else if( vel.x < 0 ) { vel.Set( 0, -1 ); n = y_height; pos.x = 0; }
 				else if( vel.y < 0 ) { vel.Set( 1, 0 ); n = x_width; }
 				std::cout << "n, vel: " << n << ", " << vel.x << ", " << vel.y << std::endl;
-				actual_vel = types::ivector2( vel.x * border.GetWidth(), vel.y * border.GetHeight() );
+				actual_vel = types::ivector2( vel.x * cell_w, vel.y * cell_h );
 				new_pos = pos + actual_vel;
 			}
 			
@@ -439,34 +446,53 @@ void DoAGrid( const GridParams& params, const std::string& output_filename )
 		}
 	}
 
-	SaveImage( output_filename, image );
+	if( draw_list )
+	{
+		draw_list->Render( image, page_arena );
+		draw_list->Clear();
+		text_run_cache.Unpin();
+	}
+
+	SaveImage( output_filename, image, page_arena );
+	image.Clear();
+	if( page_arena )
+		page_arena->Reset();
 }
 
-void PrintAGrid( ceng::CArray2D< std::string > elements, GridParams params, std::string output_filename )
+// page_arena works the same way as in DoAGrid()
+void PrintAGrid( const ceng::CArray2D< std::string >& elements, const GridParams& params, const std::string& output_filename, ceng::CArena* page_arena = NULL )
 {
-	ceng::CArray2D< Uint32 > image( params.image_w, params.image_h );
+	// the page itself is in page_arena too, and goes with the Reset()
+	ceng::CArray2D< Uint32 > image;
+	image.SetArena( page_arena );
+	image.ResizeUninitialized( params.image_w, params.image_h );
 	image.SetEverythingTo( params.background_color );
-	CreateFont( params.font, params.font_size );
+	ceng::SetBlendSpace( params.linear_blend ? ceng::BLEND_LINEAR : ceng::BLEND_GAMMA );
+	ceng::CFont* font = NULL;
+	ceng::CSDFFont* sdf_font = NULL;
+	if( params.font_sdf )
+		sdf_font = CreateSDFFont( params.font );
+	else
+		font = CreateFont( params.font, params.font_size, params.font_cache_dir );
 
 	// SaveImage( output_filename, image );
 
+	// the runs recorded into the draw list have to stay in the cache until
+	// it's rendered
+	ceng::CDrawList* draw_list = params.deferred ? &page_draw_list : NULL;
+	if( draw_list )
+		text_run_cache.Pin();
+
 	float square_w = params.image_w / (float)elements.GetWidth();
 	float square_h = params.image_h / (float)elements.GetHeight();
-	ceng::CArray2D< Uint32 > border( (int)(square_w + 0.5f), (int)(square_h + 0.5f) );
-	
-	for( int y = 0; y < border.GetHeight(); ++y )
-	{
-		for( int x = 0; x < border.GetWidth(); ++x )
-		{
-			Uint32 c = params.foreground_color;		
-			if( x >= params.border_size && x < border.GetWidth() - params.border_size &&
-				y >= params.border_size && y < border.GetHeight() - params.border_size )
-			{
-				c = params.background_color;
-			}
-			border.At( x, y ) = c;
-		}
-	}
+	const int cell_w = (int)(square_w + 0.5f);
+	const int cell_h = (int)(square_h + 0.5f);
+
+	// auto fit sizes come from the metrics only, each size that gets picked
+	// is baked once by the registry (or just sampled at it with sdf)
+	ceng::CFontSource* fit_source = params.font_auto_fit ? font_registry.GetSource( params.font ) : NULL;
+	const float interior_w = (float)( cell_w - 2 * params.border_size );
+	const float interior_h = (float)( cell_h - 2 * params.border_size );
 
 	for( int y = 0; y < elements.GetHeight(); ++y )
 	{
@@ -476,13 +502,35 @@ void PrintAGrid( ceng::CArray2D< std::string > elements, GridParams params, std:
 			pos.x *= square_w;
 			pos.y *= square_h;
 
-			BlitImage( border, image, pos.x, pos.y );
-			BlitText( elements.At( x, y ), image, pos.x + border.GetWidth() / 2, pos.y + border.GetHeight() / 2, params.foreground_color );
+			ceng::CFont* cell_font = font;
+			float cell_size = params.font_size;
+			if( fit_source )
+			{
+				cell_size = fit_source->FitTextSize( elements.At( x, y ), interior_w, interior_h, std::min( params.font_min_size, params.font_size ), params.font_size );
+				if( sdf_font == NULL )
+					cell_font = font_registry.GetFont( params.font, cell_size );
+			}
+
+			DrawCell( image, pos.x, pos.y, cell_w, cell_h, params, draw_list );
+			if( sdf_font )
+				BlitText( sdf_font, cell_size, elements.At( x, y ), image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
+			else
+				BlitText( cell_font, elements.At( x, y ), image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
 
 		}
 	}
 
-	SaveImage( output_filename, image );
+	if( draw_list )
+	{
+		draw_list->Render( image, page_arena );
+		draw_list->Clear();
+		text_run_cache.Unpin();
+	}
+
+	SaveImage( output_filename, image, page_arena );
+	image.Clear();
+	if( page_arena )
+		page_arena->Reset();
 }
 
 int main(int argc, char *argv[])
@@ -505,6 +553,12 @@ int main(int argc, char *argv[])
 	gridparams.n = 72;
 	gridparams.font = "data/fonts/arial.ttf";
 	gridparams.font_size = 64;
+	gridparams.font_cache_dir = "data/fonts/cache/";
+	gridparams.font_auto_fit = false;
+	gridparams.font_min_size = 8;
+	gridparams.font_sdf = false;
+	gridparams.linear_blend = false;
+	gridparams.deferred = false;
 	gridparams.background_color = 0xFFFFFFFF;
 	gridparams.foreground_color = 0x000000FF;
 	gridparams.border_size = 5;
@@ -524,7 +578,8 @@ int main(int argc, char *argv[])
 		}
 	}*/
 
-	PrintAGrid( elements, gridparams, "printout.png" );
-	// DoAGrid( gridparams, "grid_test.png" );
+	ceng::CArena page_arena;
+	PrintAGrid( elements, gridparams, "printout.png", &page_arena );
+	// DoAGrid( gridparams, "grid_test.png", &page_arena );
 	return 0;
 }
@@ -1,131 +1,158 @@
-#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <map>
 
-namespace types
-{
-	struct rect
-	{
-		rect() : x(0),y(0),w(0),h(0) { }
-		rect( float x, float y, float w, float h ) : x(x), y(y), w(w), h(h) { }
-		float x, y, w, h;
-	};
-}
 #include "utils/array2d/carray2d.h"
+#include "utils/array2d/carray2dview.h"
 #include "utils/math/cvector2.h"
+#include "utils/math/crect.h"
 #include "utils/color/ccolor.cpp"
+#include "utils/color/cblend.cpp"
+#include "utils/memory/carena.cpp"
+
+typedef ceng::uint32 Uint32;
 
 // #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb/stb_image_write.h"
+#include "utils/image/cpngencoder.cpp"
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb/stb_truetype.h"
 
-template< class T >
-T CastFromString( const std::string& str )
-{
-	T result;
-	std::stringstream ss( str );
-	ss.operator>>( result );
-	return result;
-}
+#include "utils/filesystem/cmappedfile.cpp"
+#include "utils/font/cfont.cpp"
+#include "utils/font/csdffont.cpp"
+#include "utils/font/cfontregistry.cpp"
+#include "utils/font/ctextrun.cpp"
+#include "utils/render/cdrawlist.cpp"
+#include "utils/render/ctrim.cpp"
 
+// the pixels as stb decoded them, used in place through GetView()
 struct TempTexture
 {
+	TempTexture() : width( 0 ), height( 0 ), data( NULL ) { }
+
 	~TempTexture() 
 	{
-		delete [] data;
+		stbi_image_free( data );
 		data = NULL;
 	}
 
-	int width, height;
-	unsigned char *data;
-
-	int ColorClamp( int i, int size )
+	ceng::CArray2DView< const Uint32 > GetView() const 
 	{
-		if( i < 0 )  i += size * (int)(((-i) / size) + 1);
-		if( i >= size ) i = i % size;
-		return i;
+		return ceng::CArray2DView< const Uint32 >( (const Uint32*)data, width, height, width );
 	}
 
-	Uint32 GetPixel( int x, int y, bool include_alpha )
-	{
-		if( data == NULL ) return 0;
-
-		x = ColorClamp( x, width );
-		y = ColorClamp( y, height );
-		int bpp = 4;
-		int co = ( y * width ) * bpp + x * bpp;
-
-		Uint32 result = 
-			data[ co ] << 0 |
-			data[ co+1 ] << 8 |
-			data[ co+2 ] << 16; 
-
-		if( include_alpha ) 
-			result |= data[ co+3 ] << 24;
+	int width, height;
+	unsigned char *data;
 
-		return result;
-	}
+private:
+	TempTexture( const TempTexture& other );
+	TempTexture& operator=( const TempTexture& other );
 };
 
-void LoadImage( const std::string& filename, ceng::CArray2D< Uint32 >& out_array2d )
+bool LoadImage( const std::string& filename, TempTexture& surface )
 {
-	bool include_alpha = true;
 	int bpp;
-	TempTexture* surface = new TempTexture;
-	surface->data = stbi_load(filename.c_str(), &surface->width, &surface->height, &bpp, 4);
-	if( surface->data == NULL ) std::cout << "LoadImage - Couldn't load file: " << filename << std::endl;
-	
-	out_array2d.Resize( surface->width, surface->height );
+	stbi_image_free( surface.data );
+	surface.data = stbi_load(filename.c_str(), &surface.width, &surface.height, &bpp, 4);
+	if( surface.data == NULL ) 
+	{
+		std::cout << "LoadImage - Couldn't load file: " << filename << std::endl;
+		surface.width = 0;
+		surface.height = 0;
+		return false;
+	}
 
-	if( surface )
+	// stb gives the pixels as R, G, B, A bytes, converted in place if the
+	// images are kept in some other order
+	if( ceng::CSameFormat< ceng::PixelRGBA8, ceng::PixelNative >::value == false )
 	{
-		for( int y = 0; y < surface->height; ++y )
+		for( int y = 0; y < surface.height; ++y )
 		{
-			for( int x = 0; x < surface->width; ++x )
-			{
-				out_array2d.Rand( x, y ) = surface->GetPixel( x, y, include_alpha );
-			}
+			unsigned char* row = surface.data + (size_t)4 * surface.width * y;
+			ceng::ConvertRow< ceng::PixelRGBA8, ceng::PixelNative >( row, row, surface.width );
 		}
 	}
 
-	delete surface;
+	return true;
 }
 
-void SaveImage( const std::string& filename, const ceng::CArray2D< unsigned int >& image_data )
+void LoadImage( const std::string& filename, ceng::CArray2D< Uint32 >& out_array2d )
+{
+	TempTexture surface;
+	LoadImage( filename, surface );
+
+	// every pixel gets written below
+	out_array2d.ResizeUninitialized( surface.width, surface.height );
+	ceng::CopyView< Uint32 >( surface.GetView(), out_array2d );
+}
+
+// the png writer's buffers, and a staging copy if one is needed, come from
+// arena when there is one. Pages can't be saved on two threads at once,
+// see ceng::EncodePNG()
+void SaveImage( const std::string& filename, const ceng::CArray2DView< const Uint32 >& image_data, ceng::CArena* arena = NULL )
 {
 	// do the file and save it
 	const int w = image_data.GetWidth();
 	const int h = image_data.GetHeight();
-	
-	unsigned char* pixels = NULL;
-	pixels = new unsigned char[ 4 * w * h ];	
 
-	ceng::CColorUint8 c;
-	for( int y = 0; y < h; ++y )
+	// stb_image_write works its buffer sizes out in int, ( 4 * w + 1 ) * h
+	// bytes has to fit or the png comes out garbled
+	if( w > ( INT_MAX - 1 ) / 4 || ( h > 0 && 4 * w + 1 > INT_MAX / h ) )
 	{
-		for( int x = 0; x < w; ++x )
-		{
-			c.Set32( image_data.Rand( x, y ) );
+		std::cout << "SaveImage - image too large to save as png: " << filename << " (" << w << " x " << h << ")" << std::endl;
+		return;
+	}
 
-			int p = ( 4 * x + 4 * w * y);
-			pixels[ p + 0 ] = c.GetR();
-			pixels[ p + 1 ] = c.GetG();
-			pixels[ p + 2 ] = c.GetB();
-			pixels[ p + 3 ] = c.GetA();
+	// the png wants R, G, B, A bytes, if that's what the pixels are already
+	// they are written from where they are
+	const void* png_pixels = image_data.GetData();
+	int png_stride = image_data.GetStride() * 4;
+
+	ceng::CSafeArray< unsigned char > pixels;
+	if( ceng::CSameFormat< ceng::PixelNative, ceng::PixelRGBA8 >::value == false )
+	{
+		pixels.SetArena( arena );
+		pixels.ResizeUninitialized( (ptrdiff_t)4 * w * h );
+
+		for( int y = 0; y < h; ++y )
+		{
+			ceng::ConvertRow< ceng::PixelNative, ceng::PixelRGBA8 >( image_data.Row( y ), pixels.data + (size_t)4 * w * y, w );
 		}
+
+		png_pixels = pixels.data;
+		png_stride = w * 4;
 	}
 
-	stbi_write_png( filename.c_str(), w, h, 4, pixels, w * 4 );
-	// poro::IPlatform::Instance()->GetGraphics()->ImageSave( filename.c_str(), w, h, 4, pixels, w * 4 );
+	// encoded in memory and written with one unbuffered fwrite, so stdio
+	// doesn't allocate a buffer of its own for every page
+	int png_size = 0;
+	unsigned char* png = ceng::EncodePNG( (const unsigned char*)png_pixels, png_stride, w, h, png_size, arena );
+
+	bool ok = false;
+	FILE* file = png ? fopen( filename.c_str(), "wb" ) : NULL;
+	if( file )
+	{
+		setvbuf( file, NULL, _IONBF, 0 );
+		ok = fwrite( png, 1, png_size, file ) == (size_t)png_size;
+		if( fclose( file ) != 0 )
+			ok = false;
+	}
+
+	ceng::FreePNG( png, arena );
 
-	delete [] pixels;
-	pixels = NULL;
+	if( ok == false )
+		std::cout << "SaveImage - Couldn't write file: " << filename << std::endl;
+
+	// poro::IPlatform::Instance()->GetGraphics()->ImageSave( filename.c_str(), w, h, 4, pixels, w * 4 );
 }
 
 
@@ -136,6 +163,13 @@ struct GridParams
 	int n;		// number of elements
 	std::string font;
 	float font_size;
+	std::string font_cache_dir;	// baked fonts are cached here, empty disables the cache
+	bool font_auto_fit;			// PrintAGrid picks the largest size up to font_size that fits each cell
+	float font_min_size;		// auto fit never goes below this
+	bool font_sdf;				// draw from one distance field atlas instead of a bitmap font per size
+	bool linear_blend;			// blend anti-aliased edges in linear light instead of on the sRGB values
+	bool deferred;				// record the page and render it a band of rows at a time. Only
+								// the order the page is written in changes, nothing is kept
 	Uint32 background_color;
 	Uint32 foreground_color;
 	int border_size;
@@ -143,69 +177,34 @@ struct GridParams
 
 
 
-struct CharQuad
-{
-	CharQuad() : rect(), offset(), width( 0 ) { }
-	CharQuad( const types::rect& rect, const types::vector2& offset, float width ) : rect( rect ), offset( offset ), width( width ) { }
+ceng::CFontRegistry font_registry;
+ceng::CTextRunCache text_run_cache;
 
-	types::rect			rect;
-	types::vector2		offset;
-	float				width;
-	float				height;
+// deferred pages are recorded into this. It's emptied once the page is
+// rendered, the command storage stays for the next page
+ceng::CDrawList page_draw_list;
 	
-};
-
-unsigned char ttf_buffer[1<<25];
-
-const int bitmap_width = 4096;
-const int bitmap_height = 20480;
-
-unsigned char bmap[ bitmap_width * bitmap_height ];
-std::vector< CharQuad > char_quads;
-	
-void CreateFont(
+ceng::CFont* CreateFont(
 	const std::string& ttf_file,
-	float size )
+	float size,
+	const std::string& cache_dir )
 {
-	memset( bmap, 0, bitmap_width*bitmap_height );
-	memset( ttf_buffer, 0, 1 << 25 );
-	FILE* fptr = fopen(ttf_file.c_str(), "rb");
+	font_registry.SetCacheDir( cache_dir );
 
-	if( fptr == NULL ) 
-	{
+	ceng::CFont* font = font_registry.GetFont( ttf_file, size );
+	if( font == NULL )
 		std::cout << "Error reading file: " << ttf_file << std::endl;
-		return;
-	}
 
-	fread(ttf_buffer, 1, 1<<25, fptr);
-
-	stbtt_bakedchar g_cdata[95]; // ASCII 32..126 is 95 glyphs
-	stbtt_BakeFontBitmap( ttf_buffer, 0, size, bmap, bitmap_width, bitmap_height, 32, 95, g_cdata);
-
-	int tsize_x = 0;
-	int tsize_y = 0;
+	return font;
+}
 
-	if( char_quads.size() < 95 + 32 )
-		char_quads.resize( 95 + 32 );
+ceng::CSDFFont* CreateSDFFont( const std::string& ttf_file )
+{
+	ceng::CSDFFont* font = font_registry.GetSDFFont( ttf_file );
+	if( font == NULL )
+		std::cout << "Error reading file: " << ttf_file << std::endl;
 
-	for( int i = 0; i < 95; ++i ) 
-	{
-		char_quads[ i + 32 ] = CharQuad(
-				types::rect( 
-					(float)g_cdata[ i ].x0, 
-					(float)g_cdata[ i ].y0,
-					(float)(g_cdata[ i ].x1 - g_cdata[ i ].x0),
-					(float)(g_cdata[ i ].y1 - g_cdata[ i ].y0) ),
-				types::vector2( 
-					g_cdata[ i ].xoff, 
-					g_cdata[ i ].yoff ),
-				g_cdata[ i ].xadvance );
-		
-		char_quads[ i + 32 ].height = size;
-
-		if( g_cdata[ i ].x1 > tsize_x ) tsize_x = g_cdata[ i ].x1;
-		if( g_cdata[ i ].y1 > tsize_y ) tsize_y = g_cdata[ i ].y1;
-	}
+	return font;
 }
 
 // -- reading CSV files --
@@ -339,144 +338,194 @@ void LoadCSVFile( const std::string& csv_file, ceng::CArray2D< std::string >& re
 }
 
 
-void BlitImage( ceng::CArray2D< Uint32 >& blit_this, ceng::CArray2D< Uint32 >& to_here, int pos_x, int pos_y )
+void FillRect( const ceng::CArray2DView< Uint32 >& to_here, int pos_x, int pos_y, int w, int h, Uint32 color )
 {
-	for( int y = 0; y < blit_this.GetHeight(); ++y )
+	const int x0 = std::max( 0, pos_x );
+	const int y0 = std::max( 0, pos_y );
+	const int x1 = std::min( to_here.GetWidth(), pos_x + w );
+	const int y1 = std::min( to_here.GetHeight(), pos_y + h );
+	if( x1 <= x0 )
+		return;
+
+	for( int y = y0; y < y1; ++y )
 	{
-		for( int x = 0; x < blit_this.GetWidth(); ++x )
-		{
-			if( to_here.IsValid( x + pos_x, y + pos_y ) )
-			{
-				to_here.At( x + pos_x, y + pos_y ) = blit_this.At( x, y );
-			}
-		}
+		Uint32* row = to_here.Row( y );
+		std::fill( row + x0, row + x1, color );
 	}
 }
 
-void BlitImageWithBorder( ceng::CArray2D< Uint32 >& blit_this, ceng::CArray2D< Uint32 >& to_here, int pos_x, int pos_y, int border_x, int border_y )
+// outline thickness pixels wide drawn inside the rectangle
+void StrokeRect( const ceng::CArray2DView< Uint32 >& to_here, int pos_x, int pos_y, int w, int h, int thickness, Uint32 color )
+{
+	const int top = std::min( thickness, h );
+	const int bottom = std::max( top, h - thickness );
+	const int left = std::min( thickness, w );
+	const int right = std::max( left, w - thickness );
+
+	FillRect( to_here, pos_x, pos_y, w, top, color );
+	FillRect( to_here, pos_x, pos_y + bottom, w, h - bottom, color );
+	FillRect( to_here, pos_x, pos_y + top, left, bottom - top, color );
+	FillRect( to_here, pos_x + right, pos_y + top, w - right, bottom - top, color );
+}
+
+void BlitImageWithBorder( const ceng::CArray2DView< const Uint32 >& blit_this, const ceng::CArray2DView< Uint32 >& to_here, int pos_x, int pos_y, int border_x, int border_y )
 {
-	for( int y = 0; y < blit_this.GetHeight() + 2 * border_y; ++y )
+	const Uint32 border_color = 0xFFe8e8e8;
+	const int w = blit_this.GetWidth();
+	const int h = blit_this.GetHeight();
+	if( w <= 0 || h <= 0 )
+		return;
+
+	// the whole area, image and border, clipped to the destination
+	const int x0 = std::max( 0, -pos_x );
+	const int y0 = std::max( 0, -pos_y );
+	const int x1 = std::min( w + 2 * border_x, to_here.GetWidth() - pos_x );
+	const int y1 = std::min( h + 2 * border_y, to_here.GetHeight() - pos_y );
+	if( x1 <= x0 )
+		return;
+
+	// the image spans [ border_x, border_x + w ] in both directions, so its
+	// last column and last row show up twice
+	const int ix0 = std::max( x0, border_x );
+	const int ix1 = std::min( x1, border_x + w + 1 );
+	const int copy_end = std::min( ix1, border_x + w );
+
+	for( int y = y0; y < y1; ++y )
 	{
-		for( int x = 0; x < blit_this.GetWidth() + 2 * border_x; ++x )
+		Uint32* row = to_here.Row( pos_y + y );
+		if( y < border_y || y > border_y + h || ix1 <= ix0 )
 		{
-			if( to_here.IsValid( x + pos_x, y + pos_y ) == false )
-				continue;
-
-			if( x < border_x || y < border_y || x > border_x + blit_this.GetWidth() || y > border_y + blit_this.GetHeight() )
-			{
-				to_here.At( x + pos_x, y + pos_y ) = 0xFFe8e8e8;
-			}
-			else
-			{
-				to_here.At( x + pos_x, y + pos_y ) = blit_this.At( x - border_x, y - border_y );
-			}
+			std::fill( row + pos_x + x0, row + pos_x + x1, border_color );
+			continue;
 		}
+
+		const Uint32* src = blit_this.Row( std::min( y - border_y, h - 1 ) );
+
+		std::fill( row + pos_x + x0, row + pos_x + ix0, border_color );
+		if( copy_end > ix0 )
+			memcpy( row + pos_x + ix0, src + ix0 - border_x, ( copy_end - ix0 ) * sizeof( Uint32 ) );
+		if( ix1 > copy_end )
+			row[ pos_x + copy_end ] = src[ w - 1 ];
+		std::fill( row + pos_x + std::max( ix1, x0 ), row + pos_x + x1, border_color );
 	}
 }
 
-Uint32 CastToColor( Uint32 c1, Uint32 c2, unsigned char how_much_of_1 )
+// records into draw_list instead of drawing if there is one
+void BlitTextRun( const ceng::CTextRun* run, const ceng::CArray2DView< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor, ceng::CDrawList* draw_list = NULL )
 {
-	if( c1 == c2 ) return c1;
-	float how_much = (float)(how_much_of_1) / 255.f;
+	if( run == NULL )
+		return;
+
+	int pos_x = (int)( center_x - 0.5f * run->width + 0.5f); 
+	int pos_y = (int)( center_y + 0.5f * run->height + 0.5f ); 
 
-	/*
-	unsigned int c = 255 - how_much_of_1;
-	types::fcolor color1;
-	color1.Set8( c, c, c, 255 );
-	return color1.Get32();*/
+	int px = pos_x + run->left;
+	int py = pos_y + run->top;
 
-	types::fcolor color1( c1 );
-	types::fcolor color2( c2 );
+	if( draw_list )
+	{
+		draw_list->BlitText( run, px, py, fcolor );
+		return;
+	}
+
+	// only the non-zero spans get touched, clipped against the image
+	for( std::size_t i = 0; i < run->spans.size(); ++i )
+	{
+		const ceng::CCoverageSpan& span = run->spans[ i ];
+		const int y = py + span.y;
+		if( y < 0 || y >= to_here.GetHeight() ) 
+			continue;
+
+		const int x0 = std::max( span.x, -px );
+		const int x1 = std::min( span.x + span.length, to_here.GetWidth() - px );
+		if( x1 <= x0 ) 
+			continue;
+
+		Uint32* row = to_here.Row( y ) + px + x0;
+		if( span.opaque )
+			ceng::FillCoverageSpan( row, x1 - x0, fcolor );
+		else
+			ceng::BlendCoverageSpan( row, run->coverage.Row( span.y ) + x0, x1 - x0, fcolor );
+	}
+}
 
-	types::fcolor result = how_much * color1 + ( 1.f - how_much ) * color2;
+void BlitText( ceng::CFont* font, const std::string& text, const ceng::CArray2DView< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor, ceng::CDrawList* draw_list = NULL )
+{
+	BlitTextRun( text_run_cache.GetRun( font, text ), to_here, center_x, center_y, fcolor, draw_list );
+}
 
-	std::swap( result.r, result.a );
-	// result.SetR( ( color1.GetR() > color2.GetR() )? color1.GetR() : color2.GetR() );
-	return result.Get32();
+void BlitText( ceng::CSDFFont* font, float size, const std::string& text, const ceng::CArray2DView< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor, ceng::CDrawList* draw_list = NULL )
+{
+	BlitTextRun( text_run_cache.GetRun( font, size, text ), to_here, center_x, center_y, fcolor, draw_list );
 }
 
-void BlitText( const std::string& text, ceng::CArray2D< Uint32 >& to_here, int center_x, int center_y, Uint32 fcolor )
+// outline in the foreground color, inside in the background color
+void DrawCell( const ceng::CArray2DView< Uint32 >& image, int pos_x, int pos_y, int w, int h, const GridParams& params, ceng::CDrawList* draw_list )
 {
-	float width = 0;
-	float height = 0;
-	for( std::size_t i = 0; i < text.size(); ++i ) 
+	const int border = params.border_size;
+	if( draw_list )
 	{
-		char c = text[i];
-		if( c > char_quads.size() ) continue;
-		width += char_quads[ c ].width;
-		height = std::max( char_quads[ c ].rect.h, height );
+		draw_list->StrokeRect( pos_x, pos_y, w, h, border, params.foreground_color );
+		draw_list->FillRect( pos_x + border, pos_y + border, w - 2 * border, h - 2 * border, params.background_color );
 	}
-	
-	int pos_x = (int)( center_x - 0.5f * width + 0.5f); 
-	int pos_y = (int)( center_y + 0.5f * height + 0.5f ); 
-	
-	for( std::size_t i = 0; i < text.size(); ++i ) 
+	else
 	{
-		char c = text[i];
-		if( c > char_quads.size() ) continue;
-
-		int px =(int)( pos_x + char_quads[c].offset.x );
-		int py =(int)( pos_y + char_quads[c].offset.y );
-
-		for( int y = 0; y < char_quads[c].rect.h; ++y )
-		{
-			for( int x = 0; x < char_quads[c].rect.w; ++x )
-			{
-				int bitx = x + char_quads[c].rect.x;
-				int bity = y + char_quads[c].rect.y;
-			
-				unsigned char color = bmap[ bitx + bitmap_width * bity ];
-				// if( color > 0 )
-				{
-					to_here.At( px + x, py + y ) = CastToColor( fcolor, to_here.At( px + x, py + y ), color );
-				}
-			
-			}
-		}
-
-		pos_x += char_quads[c].width;
+		StrokeRect( image, pos_x, pos_y, w, h, border, params.foreground_color );
+		FillRect( image, pos_x + border, pos_y + border, w - 2 * border, h - 2 * border, params.background_color );
 	}
 }
 
-void DoAGrid( const GridParams& params, const std::string& output_filename )
+// page_arena holds the render and save temporaries, it's reset once the
+// page is saved. Callers drawing many pages keep one for all of them, the
+// memory is then already there for the next page. NULL uses the heap
+void DoAGrid( const GridParams& params, const std::string& output_filename, ceng::CArena* page_arena = NULL )
 {
-	ceng::CArray2D< Uint32 > image( params.image_w, params.image_h );
+	// the page itself is in page_arena too, and goes with the Reset()
+	ceng::CArray2D< Uint32 > image;
+	image.SetArena( page_arena );
+	image.ResizeUninitialized( params.image_w, params.image_h );
 	image.SetEverythingTo( params.background_color );
-	CreateFont( params.font, params.font_size );
+	ceng::SetBlendSpace( params.linear_blend ? ceng::BLEND_LINEAR : ceng::BLEND_GAMMA );
+	ceng::CFont* font = NULL;
+	ceng::CSDFFont* sdf_font = NULL;
+	if( params.font_sdf )
+		sdf_font = CreateSDFFont( params.font );
+	else
+		font = CreateFont( params.font, params.font_size, params.font_cache_dir );
 
 	// SaveImage( output_filename, image );
 
+	// the runs recorded into the draw list have to stay in the cache until
+	// it's rendered
+	ceng::CDrawList* draw_list = params.deferred ? &page_draw_list : NULL;
+	if( draw_list )
+		text_run_cache.Pin();
+
 	float square_size = (float)( params.image_w * 2 + params.image_h * 2 ) / (float)( params.n + 4 );
-	ceng::CArray2D< Uint32 > border( (int)(square_size + 0.5f), (int)(square_size + 0.5f) );
-	
-	for( int y = 0; y < border.GetHeight(); ++y )
-	{
-		for( int x = 0; x < border.GetWidth(); ++x )
-		{
-			Uint32 c = params.foreground_color;		
-			if( x >= params.border_size && x < border.GetWidth() - params.border_size &&
-				y >= params.border_size && y < border.GetHeight() - params.border_size )
-			{
-				c = params.background_color;
-			}
-			border.At( x, y ) = c;
-		}
-	}
+	const int cell_w = (int)(square_size + 0.5f);
+	const int cell_h = (int)(square_size + 0.5f);
 
 	{
 		types::ivector2 pos( 0, 0 );
 		types::ivector2 vel( 1, 0 );
-		int x_width = params.image_w / border.GetWidth();
-		int y_height = params.image_h / border.GetHeight();
+		int x_width = params.image_w / cell_w;
+		int y_height = params.image_h / cell_h;
 		int n = x_width;
+		std::string label;
 		for( int i = 0; i < params.n - 1; ++i )
 		{
-			BlitImage( border, image, pos.x, pos.y );
-			std::stringstream ss;
-			ss << ( i);
-			BlitText( ss.str(), image, pos.x + border.GetWidth() / 2, pos.y + border.GetHeight() / 2, params.foreground_color );
+			DrawCell( image, pos.x, pos.y, cell_w, cell_h, params, draw_list );
+
+			// short enough to stay in the string itself, no stream per label
+			char number[ 16 ];
+			sprintf( number, "%d", i );
+			label.assign( number );
+			if( sdf_font )
+				BlitText( sdf_font, params.font_size, label, image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
+			else
+				BlitText( font, label, image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
 
-			types::ivector2 actual_vel = types::ivector2( vel.x * border.GetWidth(), vel.y * border.GetHeight() );
+			types::ivector2 actual_vel = types::ivector2( vel.x * cell_w, vel.y * cell_h );
 			types::ivector2 new_pos = pos + actual_vel;
 			n--;
 			if( n <= 0 )
@@ -493,7 +542,7 @@ void DoAGrid( const GridParams& params, const std::string& output_filename )
 				else if( vel.x < 0 ) { vel.Set( 0, -1 ); n = y_height; pos.x = 0; }
 				else if( vel.y < 0 ) { vel.Set( 1, 0 ); n = x_width; }
 				std::cout << "n, vel: " << n << ", " << vel.x << ", " << vel.y << std::endl;
-				actual_vel = types::ivector2( vel.x * border.GetWidth(), vel.y * border.GetHeight() );
+				actual_vel = types::ivector2( vel.x * cell_w, vel.y * cell_h );
 				new_pos = pos + actual_vel;
 			}
 			
@@ -501,34 +550,53 @@ void DoAGrid( const GridParams& params, const std::string& output_filename )
 		}
 	}
 
-	SaveImage( output_filename, image );
+	if( draw_list )
+	{
+		draw_list->Render( image, page_arena );
+		draw_list->Clear();
+		text_run_cache.Unpin();
+	}
+
+	SaveImage( output_filename, image, page_arena );
+	image.Clear();
+	if( page_arena )
+		page_arena->Reset();
 }
 
-void PrintAGrid( ceng::CArray2D< std::string > elements, GridParams params, std::string output_filename )
+// page_arena works the same way as in DoAGrid()
+void PrintAGrid( const ceng::CArray2D< std::string >& elements, const GridParams& params, const std::string& output_filename, ceng::CArena* page_arena = NULL )
 {
-	ceng::CArray2D< Uint32 > image( params.image_w, params.image_h );
+	// the page itself is in page_arena too, and goes with the Reset()
+	ceng::CArray2D< Uint32 > image;
+	image.SetArena( page_arena );
+	image.ResizeUninitialized( params.image_w, params.image_h );
 	image.SetEverythingTo( params.background_color );
-	CreateFont( params.font, params.font_size );
+	ceng::SetBlendSpace( params.linear_blend ? ceng::BLEND_LINEAR : ceng::BLEND_GAMMA );
+	ceng::CFont* font = NULL;
+	ceng::CSDFFont* sdf_font = NULL;
+	if( params.font_sdf )
+		sdf_font = CreateSDFFont( params.font );
+	else
+		font = CreateFont( params.font, params.font_size, params.font_cache_dir );
 
 	// SaveImage( output_filename, image );
 
+	// the runs recorded into the draw list have to stay in the cache until
+	// it's rendered
+	ceng::CDrawList* draw_list = params.deferred ? &page_draw_list : NULL;
+	if( draw_list )
+		text_run_cache.Pin();
+
 	float square_w = params.image_w / (float)elements.GetWidth();
 	float square_h = params.image_h / (float)elements.GetHeight();
-	ceng::CArray2D< Uint32 > border( (int)(square_w + 0.5f), (int)(square_h + 0.5f) );
-	
-	for( int y = 0; y < border.GetHeight(); ++y )
-	{
-		for( int x = 0; x < border.GetWidth(); ++x )
-		{
-			Uint32 c = params.foreground_color;		
-			if( x >= params.border_size && x < border.GetWidth() - params.border_size &&
-				y >= params.border_size && y < border.GetHeight() - params.border_size )
-			{
-				c = params.background_color;
-			}
-			border.At( x, y ) = c;
-		}
-	}
+	const int cell_w = (int)(square_w + 0.5f);
+	const int cell_h = (int)(square_h + 0.5f);
+
+	// auto fit sizes come from the metrics only, each size that gets picked
+	// is baked once by the registry (or just sampled at it with sdf)
+	ceng::CFontSource* fit_source = params.font_auto_fit ? font_registry.GetSource( params.font ) : NULL;
+	const float interior_w = (float)( cell_w - 2 * params.border_size );
+	const float interior_h = (float)( cell_h - 2 * params.border_size );
 
 	for( int y = 0; y < elements.GetHeight(); ++y )
 	{
@@ -538,41 +606,133 @@ void PrintAGrid( ceng::CArray2D< std::string > elements, GridParams params, std:
 			pos.x *= square_w;
 			pos.y *= square_h;
 
-			BlitImage( border, image, pos.x, pos.y );
-			BlitText( elements.At( x, y ), image, pos.x + border.GetWidth() / 2, pos.y + border.GetHeight() / 2, params.foreground_color );
+			ceng::CFont* cell_font = font;
+			float cell_size = params.font_size;
+			if( fit_source )
+			{
+				cell_size = fit_source->FitTextSize( elements.At( x, y ), interior_w, interior_h, std::min( params.font_min_size, params.font_size ), params.font_size );
+				if( sdf_font == NULL )
+					cell_font = font_registry.GetFont( params.font, cell_size );
+			}
+
+			DrawCell( image, pos.x, pos.y, cell_w, cell_h, params, draw_list );
+			if( sdf_font )
+				BlitText( sdf_font, cell_size, elements.At( x, y ), image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
+			else
+				BlitText( cell_font, elements.At( x, y ), image, pos.x + cell_w / 2, pos.y + cell_h / 2, params.foreground_color, draw_list );
 
 		}
 	}
 
-	SaveImage( output_filename, image );
+	if( draw_list )
+	{
+		draw_list->Render( image, page_arena );
+		draw_list->Clear();
+		text_run_cache.Unpin();
+	}
+
+	SaveImage( output_filename, image, page_arena );
+	image.Clear();
+	if( page_arena )
+		page_arena->Reset();
+}
+
+// output_file + page + ".png", into filename so its buffer gets reused
+void PageFilename( const std::string& output_file, int page, std::string& filename )
+{
+	char number[ 24 ];
+	sprintf( number, "%d.png", page );
+	filename.assign( output_file );
+	filename.append( number );
 }
 
 struct GriddifyParams
 {
 	types::ivector2 pagesize;
 	types::ivector2 bordersize;
+	bool trim_transparent;		// cut the fully transparent margins off the tokens so more fit on a page
 };
 
-void Griddify( GriddifyParams params, const ceng::CArray2D< std::string >& cvs_file, std::string output_file )
+// the count column, 0 for anything that isn't a number
+int ParseCount( const std::string& str )
 {
+	return (int)strtol( str.c_str(), NULL, 10 );
+}
 
-	ceng::CArray2D< Uint32 > data( params.pagesize.x, params.pagesize.y );
-	data.SetEverythingTo( 0xFFFFFFFF );
+// a line of the csv that prints something: count copies of tokens[ token ]
+struct GriddifyRow
+{
+	int count;
+	int token;
+};
+
+// decodes every distinct image once, trims it if asked to and copies it
+// into token_arena, so nothing gets decoded or allocated while the pages
+// are drawn. Lines without a count, or with an image that doesn't load or
+// has nothing in it, are left out of rows
+void LoadTokens( const GriddifyParams& params, const ceng::CArray2D< std::string >& cvs_file, ceng::CArena& token_arena, std::vector< ceng::CArray2DView< const Uint32 > >& tokens, std::vector< GriddifyRow >& rows )
+{
+	// filename to index in tokens, -1 if there's nothing to print
+	std::map< std::string, int > loaded;
+	TempTexture image;
 
-	types::ivector2 size( 0, 0 );
 	for( int y = 1; y < cvs_file.GetHeight(); ++y )
 	{
-		int count = CastFromString< int >( cvs_file.At( 0, y ) );
-		std::string filename = cvs_file.At( 1, y );
-		if( count <= 0 || filename.empty() ) 
+		GriddifyRow row;
+		row.count = ParseCount( cvs_file.At( 0, y ) );
+		const std::string& filename = cvs_file.At( 1, y );
+		if( row.count <= 0 || filename.empty() ) 
 			continue;
-		
-		ceng::CArray2D< Uint32 > image;
-		LoadImage( filename, image );
-		if( image.GetWidth() > size.x ) 
-			size.x = image.GetWidth();
-		if( image.GetHeight() > size.y ) 
-			size.y = image.GetHeight();
+
+		std::map< std::string, int >::const_iterator i = loaded.find( filename );
+		if( i != loaded.end() )
+		{
+			row.token = i->second;
+		}
+		else
+		{
+			row.token = -1;
+			LoadImage( filename, image );
+			const ceng::CArray2DView< const Uint32 > token = params.trim_transparent ? ceng::TrimTransparent( image.GetView() ) : image.GetView();
+			if( token.Empty() == false )
+			{
+				Uint32* pixels = (Uint32*)token_arena.Allocate( sizeof( Uint32 ) * token.GetWidth() * token.GetHeight() );
+				const ceng::CArray2DView< Uint32 > copy( pixels, token.GetWidth(), token.GetHeight(), token.GetWidth() );
+				ceng::CopyView< Uint32 >( token, copy );
+
+				row.token = (int)tokens.size();
+				tokens.push_back( copy );
+			}
+			else if( image.GetView().Empty() == false )
+			{
+				std::cout << "Griddify - " << filename << " is fully transparent, skipped" << std::endl;
+			}
+
+			loaded[ filename ] = row.token;
+		}
+
+		if( row.token >= 0 )
+			rows.push_back( row );
+	}
+}
+
+void Griddify( const GriddifyParams& params, const ceng::CArray2D< std::string >& cvs_file, const std::string& output_file )
+{
+
+	ceng::CArray2D< Uint32 > data( params.pagesize.x, params.pagesize.y, 0xFFFFFFFF );
+
+	ceng::CArena token_arena;
+	std::vector< ceng::CArray2DView< const Uint32 > > tokens;
+	std::vector< GriddifyRow > rows;
+	LoadTokens( params, cvs_file, token_arena, tokens, rows );
+
+	types::ivector2 size( 0, 0 );
+	for( std::size_t t = 0; t < tokens.size(); ++t )
+	{
+		if( tokens[ t ].GetWidth() > size.x ) 
+			size.x = tokens[ t ].GetWidth();
+		if( tokens[ t ].GetHeight() > size.y ) 
+			size.y = tokens[ t ].GetHeight();
 	}
 
 	size += params.bordersize;
@@ -592,15 +752,15 @@ void Griddify( GriddifyParams params, const ceng::CArray2D< std::string >& cvs_f
 	int page = 0;
 	int perpage = perpage_w * perpage_h;
 
-	for( int y = 1; y < cvs_file.GetHeight(); ++y )
+	// everything a page save needs is taken from here and dropped after it,
+	// after the first pages it doesn't grow anymore
+	ceng::CArena page_arena;
+	std::string page_filename;
+
+	for( std::size_t r = 0; r < rows.size(); ++r )
 	{
-		int count = CastFromString< int >( cvs_file.At( 0, y ) );
-		std::string filename = cvs_file.At( 1, y );
-		if( count <= 0 || filename.empty() ) 
-			continue;
-		
-		ceng::CArray2D< Uint32 > image;
-		LoadImage( filename, image );
+		const ceng::CArray2DView< const Uint32 >& token = tokens[ rows[ r ].token ];
+		const int count = rows[ r ].count;
 
 		for( int j = 0; j < count; ++j )
 		{
@@ -609,13 +769,13 @@ void Griddify( GriddifyParams params, const ceng::CArray2D< std::string >& cvs_f
 			pos.y = i / perpage_w;
 			pos.x = pos.x * size.x + offset.x;
 			pos.y = pos.y * size.y + offset.y;
-			BlitImageWithBorder( image, data, pos.x, pos.y, params.bordersize.x / 2, params.bordersize.y / 2 );
+			BlitImageWithBorder( token, data, pos.x, pos.y, params.bordersize.x / 2, params.bordersize.y / 2 );
 			i++;
 			if( i >= perpage )
 			{
-				std::stringstream ss;
-				ss << output_file << page << ".png";
-				SaveImage( ss.str(), data );
+				PageFilename( output_file, page, page_filename );
+				SaveImage( page_filename, data, &page_arena );
+				page_arena.Reset();
 				// PrintPage()
 				page++;
 				i = 0;
@@ -626,9 +786,9 @@ void Griddify( GriddifyParams params, const ceng::CArray2D< std::string >& cvs_f
 
 	if( i != 0 )
 	{
-		std::stringstream ss;
-		ss << output_file << page << ".png";
-		SaveImage( ss.str(), data );
+		PageFilename( output_file, page, page_filename );
+		SaveImage( page_filename, data, &page_arena );
+		page_arena.Reset();
 		// PrintPage()
 		page++;
 		i = 0;
@@ -653,6 +813,7 @@ int main(int argc, char *argv[])
 	GriddifyParams params;
 	params.pagesize.Set( 2480, 3508 );
 	params.bordersize.Set( 4, 4 );
+	params.trim_transparent = true;
 
 	ceng::CArray2D< std::string > elements;
 	LoadCSVFile( argv[1], elements );
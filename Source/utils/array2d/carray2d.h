@@ -43,6 +43,8 @@
 
 // #include <vector>
 // #include <memory>
+#include <algorithm>
+#include <new>
 
 #include "../safearray/csafearray.h"
 
@@ -102,6 +104,19 @@ public:
 		Allocate();
 	}
 
+	//! allocates without initialising and fills once with _fill, for
+	//! buffers that would otherwise be written twice before use
+	CArray2D( int _width, int _height, const _Ty& _fill ) :
+	  myWidth( _width ),
+	  myHeight( _height ),
+	  mySize( 0 ),
+	  myArraysLittleHelper( *this ),
+	  myNullReference( _Ty() )
+	{
+		Allocate( false );
+		SetEverythingTo( _fill );
+	}
+
 	CArray2D( const CArray2D< _Ty, _A >& other ) :
 		myWidth( other.myWidth ),
 		myHeight( other.myHeight ),
@@ -113,6 +128,38 @@ public:
 
 	}
 
+#if CENG_HAS_MOVE
+	//! takes over the data of other, which is left empty
+	CArray2D( CArray2D< _Ty, _A >&& other ) :
+		myWidth( other.myWidth ),
+		myHeight( other.myHeight ),
+		mySize( other.mySize ),
+		myArraysLittleHelper( *this ),
+		myNullReference( _Ty() ),
+		myDataArray( std::move( other.myDataArray ) )
+	{
+		other.myWidth = 0;
+		other.myHeight = 0;
+		other.mySize = 0;
+	}
+
+	CArray2D< _Ty, _A >& operator=( CArray2D< _Ty, _A >&& other )
+	{
+		if( this != &other )
+		{
+			myWidth = other.myWidth;
+			myHeight = other.myHeight;
+			mySize = other.mySize;
+			myDataArray = std::move( other.myDataArray );
+
+			other.myWidth = 0;
+			other.myHeight = 0;
+			other.mySize = 0;
+		}
+		return *this;
+	}
+#endif
+
 	CArray2DHelper& operator[] ( int _x ) { myArraysLittleHelper.SetX( _x ); return myArraysLittleHelper; }
 	const CArray2DHelper& operator[] ( int _x ) const { myArraysLittleHelper.SetX( _x ); return myArraysLittleHelper; }
 
@@ -126,6 +173,16 @@ public:
 		return *this;
 	}
 
+	//! exchanges the contents, the helper stays bound to this array
+	void Swap( CArray2D< _Ty, _A >& other )
+	{
+		int t;
+		t = myWidth;	myWidth = other.myWidth;	other.myWidth = t;
+		t = myHeight;	myHeight = other.myHeight;	other.myHeight = t;
+		ptrdiff_t t_size = mySize;	mySize = other.mySize;	other.mySize = t_size;
+		myDataArray.Swap( other.myDataArray );
+	}
+
 	inline int GetWidth() const
 	{
 		return myWidth;
@@ -153,11 +210,13 @@ public:
 
 	void SetWidthAndHeight( int _width, int _height ) { myWidth = _width; myHeight = _height; Allocate(); }
 
+	//! Resize() that leaves the elements of trivial types uninitialised,
+	//! for when every element is going to be written anyway
+	void ResizeUninitialized( int _width, int _height ) { myWidth = _width; myHeight = _height; Allocate( false ); }
+
 	void SetEverythingTo( const _Ty& _who )
 	{
-		int i;
-		for ( i = 0; i < mySize; i++ )
-			myDataArray[ i ] = _who;
+		myDataArray.Fill( _who );
 	}
 
 
@@ -172,7 +231,7 @@ public:
 		if ( _y >= myHeight ) _y = myHeight - 1;
 #endif
 
-		return myDataArray[ ( _y * myWidth ) + _x ];
+		return myDataArray[ Index( _x, _y ) ];
 	}
 
 
@@ -188,7 +247,7 @@ public:
 		if ( _y >= myHeight ) _y = myHeight - 1;
 #endif
 
-		return myDataArray[ ( _y * myWidth ) + _x ];
+		return myDataArray[ Index( _x, _y ) ];
 	}
 
 
@@ -198,7 +257,7 @@ public:
 #ifdef CENG_CARRAY2D_SAFE
 		if ( _x < 0 || _y < 0 || _x >= myWidth || _y >= myHeight ) return myNullReference;
 #endif
-		return myDataArray[ ( _y * myWidth ) + _x ];
+		return myDataArray[ Index( _x, _y ) ];
 	}
 
 	inline const_reference Rand( int _x, int _y ) const
@@ -206,88 +265,156 @@ public:
 #ifdef CENG_CARRAY2D_SAFE
 		if ( _x < 0 || _y < 0 || _x >= myWidth || _y >= myHeight ) return myNullReference;
 #endif
-		return myDataArray[ ( _y * myWidth ) + _x ];
+		return myDataArray[ Index( _x, _y ) ];
+	}
+
+	//! the first element of row _y. Rows are GetWidth() elements long and
+	//! follow each other, so a loop over one is a plain pointer loop the
+	//! compiler can vectorise, unlike one through At() or Rand()
+	inline _Ty* Row( int _y )
+	{
+		cassert( _y >= 0 && _y < myHeight );
+		return myDataArray.data + Index( 0, _y );
+	}
+
+	inline const _Ty* Row( int _y ) const
+	{
+		cassert( _y >= 0 && _y < myHeight );
+		return myDataArray.data + Index( 0, _y );
+	}
+
+	//! every element, row after row
+	_Ty* begin() { return myDataArray.data; }
+	_Ty* end() { return myDataArray.data + mySize; }
+	const _Ty* begin() const { return myDataArray.data; }
+	const _Ty* end() const { return myDataArray.data + mySize; }
+
+	//! calls func( row, width, y ) for each row from the top, returns func
+	//! like std::for_each does
+	template< class Func >
+	Func ForEachRow( Func func )
+	{
+		for ( int y = 0; y < myHeight; y++ )
+			func( Row( y ), myWidth, y );
+		return func;
+	}
+
+	template< class Func >
+	Func ForEachRow( Func func ) const
+	{
+		for ( int y = 0; y < myHeight; y++ )
+			func( Row( y ), myWidth, y );
+		return func;
 	}
 
 	void Rand( int _x, int _y, const _Ty& _who )
 	{
-		myDataArray[ ( _y * myWidth ) + _x ] = _who;
+		myDataArray[ Index( _x, _y ) ] = _who;
 	}
 
+	//! coordinates outside the array are clamped to its edges
 	void Set( int _x, int _y, const _Ty& _who )
 	{
+		if ( myWidth <= 0 || myHeight <= 0 ) return;
 
-		if ( _x > myWidth ) _x = myWidth;
-		if ( _y > myHeight ) _y = myHeight;
+		_x = std::max( 0, std::min( _x, myWidth - 1 ) );
+		_y = std::max( 0, std::min( _y, myHeight - 1 ) );
 
-		myDataArray[ ( _y * myWidth ) + _x ] = _who;
+		myDataArray[ Index( _x, _y ) ] = _who;
 	}
 
+	//! copies _who with its top left corner at ( _x, _y ), the parts that
+	//! fall outside this array are left out
 	void Set( int _x, int _y, const CArray2D& _who )
 	{
-		int x, y;
+		const int x0 = std::max( 0, _x );
+		const int y0 = std::max( 0, _y );
+		const int x1 = std::min( myWidth, _x + _who.GetWidth() );
+		const int y1 = std::min( myHeight, _y + _who.GetHeight() );
 
-		for ( y = 0; y <= myHeight; y++ )
+		for ( int y = y0; y < y1; y++ )
 		{
-			for ( x = 0; x <= myWidth; x++ )
-			{
-				if ( x >= _x && x <= _x + _who.GetWidth() &&
-					 y >= _y && y <= _y + _who.GetHeight() )
-				{
-					Set( x, y, _who.At( x - _x, y - _y ) );
-				}
-			}
+			for ( int x = x0; x < x1; x++ )
+				myDataArray[ Index( x, y ) ] = _who.At( x - _x, y - _y );
 		}
 	}
 
-	void Crop( const _Ty& _empty )
+	//! the smallest rectangle holding every element that isn't _empty.
+	//! Returns false and a 0 x 0 rectangle if there's nothing else
+	bool FindBounds( const _Ty& _empty, int& _x, int& _y, int& _w, int& _h ) const
 	{
+		_x = _y = _w = _h = 0;
+
+		int top = 0;
+		int bottom = myHeight;
 		int left = myWidth;
 		int right = 0;
-		int top = myHeight;
-		int bottom = 0;
 
-		int x = 0;
-		int y = 0;
+		while ( top < bottom && IsRowEmpty( Row( top ), myWidth, _empty ) )
+			top++;
 
-		for ( y = 0; y <= myHeight; y++ )
+		if ( top == bottom )
+			return false;
+
+		while ( IsRowEmpty( Row( bottom - 1 ), myWidth, _empty ) )
+			bottom--;
+
+		// only the columns outside [ left, right ) can still move the edges
+		int x, y;
+		for ( y = top; y < bottom; y++ )
 		{
-			for ( x = 0; x <= myWidth; x++ )
+			const _Ty* row = Row( y );
+			for ( x = 0; x < left; x++ )
+			{
+				if ( row[ x ] != _empty ) { left = x; break; }
+			}
+			for ( x = myWidth; x > right; x-- )
 			{
-				if ( At( x, y ) != _empty )
-				{
-					if ( x < left )		left	= x;
-					if ( x > right )	right	= x;
-					if ( y < top )		top		= y;
-					if ( y > bottom )	bottom	= y;
-				}
+				if ( row[ x - 1 ] != _empty ) { right = x; break; }
 			}
 		}
 
-		Crop( left, top, right - left, bottom - top );
+		_x = left;
+		_y = top;
+		_w = right - left;
+		_h = bottom - top;
+		return true;
 	}
 
-	void Crop( int _x, int _y, int _w, int _h )
+	//! crops away the rows and columns around the content that are all
+	//! _empty. To get at the content without copying it, use FindBounds()
+	//! and a CArray2DView
+	void Crop( const _Ty& _empty )
 	{
-		cassert(false);
-
-	    /*
-		std::vector< _Ty > tmpDataArray;
-
-		tmpDataArray.resize( ( _w + 1 ) * ( _h + 1 ) );
+		int x, y, w, h;
+		if ( FindBounds( _empty, x, y, w, h ) )
+			Crop( x, y, w, h );
+		else
+			Clear();
+	}
 
-		int x, y;
-		for ( y = _y; y <= _y + _h; y++ )
+	//! keeps the part of ( _x, _y, _w, _h ) that is inside the array. To
+	//! look at a part without copying it use a CArray2DView
+	void Crop( int _x, int _y, int _w, int _h )
+	{
+		int x0 = _x < 0 ? 0 : _x;
+		int y0 = _y < 0 ? 0 : _y;
+		int x1 = _x + _w > myWidth ? myWidth : _x + _w;
+		int y1 = _y + _h > myHeight ? myHeight : _y + _h;
+		if ( x1 <= x0 || y1 <= y0 )
 		{
-			for ( x = _x; x <= _x + _w; x++ )
-			{
-				tmpDataArray[ ( ( y - _y ) * _w ) + ( x - _x ) ] = At( x, y );
-			}
+			Clear();
+			return;
 		}
 
-		myDataArray = tmpDataArray;
-		myWidth = _w;
-		myHeight = _h;*/
+		CArray2D< _Ty, _A > cropped;
+		cropped.ResizeUninitialized( x1 - x0, y1 - y0 );
+
+		int y;
+		for ( y = y0; y < y1; y++ )
+			CArrayCopier< _Ty >::Copy( cropped.myDataArray.data + cropped.Index( 0, y - y0 ), myDataArray.data + Index( x0, y ), cropped.myWidth );
+
+		Swap( cropped );
 	}
 
 	void Clear()
@@ -300,19 +427,34 @@ public:
 
 	bool Empty() const { return myDataArray.empty(); }
 
+	//! the elements come from arena, see CSafeArray::SetArena()
+	void SetArena( CArena* arena ) { myDataArray.SetArena( arena ); }
+
 	CSafeArray< _Ty >& GetData() { return myDataArray; }
 	const CSafeArray< _Ty >& GetData() const { return myDataArray; }
 
-	CArray2D< _Ty, _A>* CopyCropped( int _x, int _y, int _w, int _h)
+	CArray2D< _Ty, _A>* CopyCropped( int _x, int _y, int _w, int _h) const
 	{
-		CArray2D< _Ty, _A>* result = new CArray2D< _Ty, _A >( _w, _h);
+		CArray2D< _Ty, _A>* result = new CArray2D< _Ty, _A >;
+		result->ResizeUninitialized( _w, _h );
+
+		// inside the array it's a copy per row, outside it the edges are
+		// repeated like At() does
+		if ( _x >= 0 && _y >= 0 && _w > 0 && _h > 0 && _x + _w <= myWidth && _y + _h <= myHeight )
+		{
+			int row;
+			for ( row = 0; row < _h; row++ )
+				CArrayCopier< _Ty >::Copy( result->myDataArray.data + result->Index( 0, row ), myDataArray.data + Index( _x, _y + row ), _w );
+
+			return result;
+		}
 
 		int x, y;
 		for ( y = _y; y < _y + _h; y++ )
 		{
 			for ( x = _x; x < _x + _w; x++ )
 			{
-				result->myDataArray[ ( ( y - _y ) * _w ) + ( x - _x ) ] = At( x, y );
+				result->myDataArray[ result->Index( x - _x, y - _y ) ] = At( x, y );
 			}
 		}
 
@@ -321,28 +463,47 @@ public:
 
 private:
 
-	void Allocate()
+	static bool IsRowEmpty( const _Ty* row, int width, const _Ty& _empty )
 	{
-		/*
-		int n_size = (myWidth + 1) * ( myHeight + 1 );
-		if( n_size != mySize )
+		int x;
+		for ( x = 0; x < width; x++ )
 		{
-			mySize = n_size;
-			myDataArray.resize( mySize + 1 );
-		}*/
+			if ( row[ x ] != _empty )
+				return false;
+		}
+		return true;
+	}
+
+	// elements from the start to ( _x, _y ). Worked out in ptrdiff_t, the
+	// size of a big image doesn't fit in an int
+	inline ptrdiff_t Index( int _x, int _y ) const
+	{
+		return (ptrdiff_t)_y * myWidth + _x;
+	}
+
+	void Allocate( bool initialize = true )
+	{
+		// a size that can't be addressed is as much an allocation failure
+		// as running out of memory, not something to wrap around silently
+		const ptrdiff_t max_size = (ptrdiff_t)( ~(size_t)0 >> 1 ) / (ptrdiff_t)sizeof( _Ty );
+		if ( myWidth < 0 || myHeight < 0 || ( myWidth > 0 && myHeight > max_size / myWidth ) )
+			throw std::bad_alloc();
 
-		int n_size = (myWidth) * ( myHeight );
+		ptrdiff_t n_size = (ptrdiff_t)myWidth * myHeight;
 		if( n_size != mySize )
 		{
 			mySize = n_size;
-			myDataArray.resize( mySize + 1 );
+			if( initialize )
+				myDataArray.Resize( mySize );
+			else
+				myDataArray.ResizeUninitialized( mySize );
 		}
 	}
 
 	int myWidth;
 	int myHeight;
 
-	int mySize;
+	ptrdiff_t mySize;
 
 	CArray2DHelper	   myArraysLittleHelper;
 
@@ -0,0 +1,153 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CArray2DView
+// ============
+//
+// A window into a two dimensional array that doesn't own anything: a
+// pointer to the top left element, width, height and a stride (elements
+// from one row to the next). It can point into a CArray2D, a part of one or
+// any buffer someone else decoded, so cropping and drawing into a sub
+// region don't copy a thing.
+//
+// Like a pointer the view is shallow, a const view can still write through
+// it. CArray2DView< const T > is the read only kind, any CArray2DView< T >
+// and CArray2D< T > converts to it. The array it points to has to outlive
+// the view and mustn't be resized while the view is in use.
+//
+//.............................................................................
+#ifndef INC_CARRAY2DVIEW_H
+#define INC_CARRAY2DVIEW_H
+
+#include "carray2d.h"
+
+namespace ceng {
+
+template< class Type > struct CRemoveConst				{ typedef Type type; };
+template< class Type > struct CRemoveConst< const Type >	{ typedef Type type; };
+
+// From for views of const elements. Views of writable ones get a type
+// nothing converts to, which takes the constructor out of the picture
+template< class _Ty, class From > struct CIfConstView				{ struct none { }; typedef none type; };
+template< class _Ty, class From > struct CIfConstView< const _Ty, From >	{ typedef From type; };
+
+template< class _Ty >
+class CArray2DView
+{
+public:
+	typedef typename CRemoveConst< _Ty >::type value_type;
+
+	CArray2DView() : myData( 0 ), myWidth( 0 ), myHeight( 0 ), myStride( 0 ) { }
+
+	CArray2DView( _Ty* data, int width, int height, int stride ) :
+		myData( data ),
+		myWidth( width ),
+		myHeight( height ),
+		myStride( stride )
+	{
+	}
+
+	//! a read only view of the writable kind. Only views of const elements
+	//! have this one
+	CArray2DView( const typename CIfConstView< _Ty, CArray2DView< value_type > >::type& other ) :
+		myData( other.GetData() ),
+		myWidth( other.GetWidth() ),
+		myHeight( other.GetHeight() ),
+		myStride( other.GetStride() )
+	{
+	}
+
+	//! the whole array
+	template< class _A >
+	CArray2DView( CArray2D< value_type, _A >& array ) :
+		myData( array.GetData().data ),
+		myWidth( array.GetWidth() ),
+		myHeight( array.GetHeight() ),
+		myStride( array.GetWidth() )
+	{
+	}
+
+	//! the whole of a const array, only for views of const elements
+	template< class _A >
+	CArray2DView( const CArray2D< typename CIfConstView< _Ty, value_type >::type, _A >& array ) :
+		myData( array.GetData().data ),
+		myWidth( array.GetWidth() ),
+		myHeight( array.GetHeight() ),
+		myStride( array.GetWidth() )
+	{
+	}
+
+	int GetWidth() const	{ return myWidth; }
+	int GetHeight() const	{ return myHeight; }
+	int GetStride() const	{ return myStride; }
+	_Ty* GetData() const	{ return myData; }
+
+	bool Empty() const { return myWidth <= 0 || myHeight <= 0; }
+
+	//! rows follow each other without a gap
+	bool IsContiguous() const { return myStride == myWidth; }
+
+	inline bool IsValid( int x, int y ) const
+	{
+		return x >= 0 && y >= 0 && x < myWidth && y < myHeight;
+	}
+
+	inline _Ty& Rand( int x, int y ) const
+	{
+		cassert( IsValid( x, y ) );
+		return myData[ (ptrdiff_t)y * myStride + x ];
+	}
+
+	//! the first element of row y, the row has GetWidth() elements
+	inline _Ty* Row( int y ) const
+	{
+		cassert( y >= 0 && y < myHeight );
+		return myData + (ptrdiff_t)y * myStride;
+	}
+
+	//! calls func( row, width, y ) for each row from the top, returns func
+	template< class Func >
+	Func ForEachRow( Func func ) const
+	{
+		for( int y = 0; y < myHeight; ++y )
+			func( Row( y ), myWidth, y );
+		return func;
+	}
+
+	//! the part of ( x, y, w, h ) that is inside this view
+	CArray2DView SubView( int x, int y, int w, int h ) const
+	{
+		int x0 = x < 0 ? 0 : x;
+		int y0 = y < 0 ? 0 : y;
+		int x1 = x + w > myWidth ? myWidth : x + w;
+		int y1 = y + h > myHeight ? myHeight : y + h;
+		if( x1 <= x0 || y1 <= y0 )
+			return CArray2DView();
+
+		return CArray2DView( myData + (ptrdiff_t)y0 * myStride + x0, x1 - x0, y1 - y0, myStride );
+	}
+
+private:
+	_Ty*	myData;
+	int		myWidth;
+	int		myHeight;
+	int		myStride;
+};
+
+//-----------------------------------------------------------------------------
+
+//! copies the overlapping top left part of from into to, row by row
+template< class _Ty >
+void CopyView( const CArray2DView< const _Ty >& from, const CArray2DView< _Ty >& to )
+{
+	const int w = from.GetWidth() < to.GetWidth() ? from.GetWidth() : to.GetWidth();
+	const int h = from.GetHeight() < to.GetHeight() ? from.GetHeight() : to.GetHeight();
+	if( w <= 0 || h <= 0 )
+		return;
+
+	for( int y = 0; y < h; ++y )
+		CArrayCopier< _Ty >::Copy( to.Row( y ), from.Row( y ), w );
+}
+
+} // end of namespace ceng
+
+#endif
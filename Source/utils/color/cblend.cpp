@@ -0,0 +1,355 @@
+#include "cblend.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( __SSE2__ ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	define CENG_BLEND_SSE2
+#	include <emmintrin.h>
+#endif
+
+// avx2 needs a compiler that can build it without building everything for it
+#if defined( CENG_BLEND_SSE2 ) && ( defined( __GNUC__ ) || ( defined( _MSC_VER ) && _MSC_VER >= 1800 ) )
+#	define CENG_BLEND_AVX2
+#	include <immintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#		define CENG_TARGET_AVX2
+#	else
+#		define CENG_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#	endif
+#endif
+
+namespace ceng {
+
+namespace {
+
+BlendSpace blend_space = BLEND_GAMMA;
+
+// linear light in 12 bits
+unsigned short	srgb_to_linear[ 256 ];
+unsigned char	linear_to_srgb[ 4096 ];
+bool			tables_built = false;
+
+// the input channel that ends up in the alpha position isn't gamma encoded
+const unsigned int alpha_source_shift = PixelNative::r_shift;
+
+void BuildTables()
+{
+	if( tables_built ) 
+		return;
+
+	for( int i = 0; i < 256; ++i )
+	{
+		const double c = i / 255.0;
+		const double l = ( c <= 0.04045 ) ? c / 12.92 : pow( ( c + 0.055 ) / 1.055, 2.4 );
+		srgb_to_linear[ i ] = (unsigned short)( l * 4095.0 + 0.5 );
+	}
+
+	for( int i = 0; i < 4096; ++i )
+	{
+		const double l = i / 4095.0;
+		const double c = ( l <= 0.0031308 ) ? l * 12.92 : 1.055 * pow( l, 1.0 / 2.4 ) - 0.055;
+		linear_to_srgb[ i ] = (unsigned char)( c * 255.0 + 0.5 );
+	}
+
+	tables_built = true;
+}
+
+void BlendSpanLinear( unsigned int* dest, const unsigned char* coverage, int count, unsigned int color )
+{
+	for( int i = 0; i < count; ++i )
+	{
+		if( coverage[ i ] )
+			dest[ i ] = BlendCoverageLinear( color, dest[ i ], coverage[ i ] );
+	}
+}
+
+void BlendSpanScalar( unsigned int* dest, const unsigned char* coverage, int count, unsigned int color )
+{
+	for( int i = 0; i < count; ++i )
+	{
+		if( coverage[ i ] )
+			dest[ i ] = BlendCoverage( color, dest[ i ], coverage[ i ] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+
+#ifdef CENG_BLEND_SSE2
+
+// 4 pixels. cov holds their coverage in the 32 bit lanes
+inline __m128i BlendSSE2( __m128i pixels, __m128i cov, __m128i color, __m128i color16 )
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	// coverage for every 16 bit channel, and 255 - coverage
+	const __m128i cov_pair = _mm_or_si128( cov, _mm_slli_epi32( cov, 16 ) );
+	const __m128i cov_lo = _mm_unpacklo_epi32( cov_pair, cov_pair );
+	const __m128i cov_hi = _mm_unpackhi_epi32( cov_pair, cov_pair );
+	const __m128i full = _mm_set1_epi16( 255 );
+	const __m128i round = _mm_set1_epi16( 128 );
+
+	__m128i lo = _mm_unpacklo_epi8( pixels, zero );
+	__m128i hi = _mm_unpackhi_epi8( pixels, zero );
+
+	lo = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( color16, cov_lo ), _mm_mullo_epi16( lo, _mm_sub_epi16( full, cov_lo ) ) ), round );
+	hi = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( color16, cov_hi ), _mm_mullo_epi16( hi, _mm_sub_epi16( full, cov_hi ) ) ), round );
+
+	// ( n + 127 ) / 255
+	lo = _mm_srli_epi16( _mm_add_epi16( lo, _mm_srli_epi16( lo, 8 ) ), 8 );
+	hi = _mm_srli_epi16( _mm_add_epi16( hi, _mm_srli_epi16( hi, 8 ) ), 8 );
+
+	__m128i result = _mm_packus_epi16( lo, hi );
+
+	// red and alpha trade places
+	result = _mm_or_si128( 
+		_mm_and_si128( result, _mm_set1_epi32( (int)( PixelNative::g_mask | PixelNative::b_mask ) ) ),
+		_mm_or_si128( _mm_srli_epi32( result, 24 ), _mm_slli_epi32( result, 24 ) ) );
+
+	// untouched where there's no coverage or the pixel already is the color
+	const __m128i keep = _mm_or_si128( _mm_cmpeq_epi32( cov, zero ), _mm_cmpeq_epi32( pixels, color ) );
+	return _mm_or_si128( _mm_and_si128( keep, pixels ), _mm_andnot_si128( keep, result ) );
+}
+
+void BlendSpanSSE2( unsigned int* dest, const unsigned char* coverage, int count, unsigned int color )
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i color32 = _mm_set1_epi32( (int)color );
+	const __m128i color16 = _mm_unpacklo_epi8( color32, zero );
+
+	int i = 0;
+	for( ; i + 4 <= count; i += 4 )
+	{
+		int cov4;
+		memcpy( &cov4, coverage + i, 4 );
+		if( cov4 == 0 ) continue;
+
+		const __m128i cov = _mm_unpacklo_epi16( _mm_unpacklo_epi8( _mm_cvtsi32_si128( cov4 ), zero ), zero );
+		const __m128i pixels = _mm_loadu_si128( (const __m128i*)( dest + i ) );
+		_mm_storeu_si128( (__m128i*)( dest + i ), BlendSSE2( pixels, cov, color32, color16 ) );
+	}
+
+	BlendSpanScalar( dest + i, coverage + i, count - i, color );
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+#ifdef CENG_BLEND_AVX2
+
+// same as BlendSSE2() for 8 pixels. The unpacks work inside the 128 bit
+// halves, which is also how packus puts them back together
+CENG_TARGET_AVX2
+void BlendSpanAVX2( unsigned int* dest, const unsigned char* coverage, int count, unsigned int color )
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i color32 = _mm256_set1_epi32( (int)color );
+	const __m256i color16 = _mm256_unpacklo_epi8( color32, zero );
+	const __m256i full = _mm256_set1_epi16( 255 );
+	const __m256i round = _mm256_set1_epi16( 128 );
+
+	int i = 0;
+	for( ; i + 8 <= count; i += 8 )
+	{
+		long long cov8;
+		memcpy( &cov8, coverage + i, 8 );
+		if( cov8 == 0 ) continue;
+
+		const __m256i cov = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)( coverage + i ) ) );
+		const __m256i pixels = _mm256_loadu_si256( (const __m256i*)( dest + i ) );
+
+		const __m256i cov_pair = _mm256_or_si256( cov, _mm256_slli_epi32( cov, 16 ) );
+		const __m256i cov_lo = _mm256_unpacklo_epi32( cov_pair, cov_pair );
+		const __m256i cov_hi = _mm256_unpackhi_epi32( cov_pair, cov_pair );
+
+		__m256i lo = _mm256_unpacklo_epi8( pixels, zero );
+		__m256i hi = _mm256_unpackhi_epi8( pixels, zero );
+
+		lo = _mm256_add_epi16( _mm256_add_epi16( _mm256_mullo_epi16( color16, cov_lo ), _mm256_mullo_epi16( lo, _mm256_sub_epi16( full, cov_lo ) ) ), round );
+		hi = _mm256_add_epi16( _mm256_add_epi16( _mm256_mullo_epi16( color16, cov_hi ), _mm256_mullo_epi16( hi, _mm256_sub_epi16( full, cov_hi ) ) ), round );
+
+		lo = _mm256_srli_epi16( _mm256_add_epi16( lo, _mm256_srli_epi16( lo, 8 ) ), 8 );
+		hi = _mm256_srli_epi16( _mm256_add_epi16( hi, _mm256_srli_epi16( hi, 8 ) ), 8 );
+
+		__m256i result = _mm256_packus_epi16( lo, hi );
+
+		result = _mm256_or_si256( 
+			_mm256_and_si256( result, _mm256_set1_epi32( (int)( PixelNative::g_mask | PixelNative::b_mask ) ) ),
+			_mm256_or_si256( _mm256_srli_epi32( result, 24 ), _mm256_slli_epi32( result, 24 ) ) );
+
+		const __m256i keep = _mm256_or_si256( _mm256_cmpeq_epi32( cov, zero ), _mm256_cmpeq_epi32( pixels, color32 ) );
+		result = _mm256_or_si256( _mm256_and_si256( keep, pixels ), _mm256_andnot_si256( keep, result ) );
+
+		_mm256_storeu_si256( (__m256i*)( dest + i ), result );
+	}
+
+	BlendSpanSSE2( dest + i, coverage + i, count - i, color );
+}
+
+bool HasAVX2()
+{
+#ifdef _MSC_VER
+	int info[ 4 ];
+	__cpuid( info, 0 );
+	if( info[ 0 ] < 7 ) 
+		return false;
+
+	// the os has to save the ymm registers too
+	__cpuid( info, 1 );
+	const bool osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+	const bool avx = ( info[ 2 ] & ( 1 << 28 ) ) != 0;
+	if( osxsave == false || avx == false || ( _xgetbv( 0 ) & 6 ) != 6 )
+		return false;
+
+	__cpuidex( info, 7, 0 );
+	return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+typedef void (*BlendSpanFunc)( unsigned int*, const unsigned char*, int, unsigned int );
+
+BlendSpanFunc	blend_span = NULL;
+const char*		blend_span_name = NULL;
+
+void PickBlendKernel()
+{
+	blend_span = BlendSpanScalar;
+	blend_span_name = "scalar";
+
+#ifdef CENG_BLEND_SSE2
+	blend_span = BlendSpanSSE2;
+	blend_span_name = "sse2";
+#endif
+
+#ifdef CENG_BLEND_AVX2
+	if( HasAVX2() )
+	{
+		blend_span = BlendSpanAVX2;
+		blend_span_name = "avx2";
+	}
+#endif
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+
+void SetBlendSpace( BlendSpace space )
+{
+	if( space == BLEND_LINEAR )
+		BuildTables();
+
+	blend_space = space;
+}
+
+BlendSpace GetBlendSpace()
+{
+	return blend_space;
+}
+
+unsigned int BlendCoverageLinear( unsigned int color, unsigned int dest, unsigned char coverage )
+{
+	if( color == dest ) return dest;
+
+	BuildTables();
+
+	const unsigned int c = coverage;
+	const unsigned int inv_c = 255 - c;
+
+	unsigned int result = 0;
+	for( unsigned int shift = 0; shift < 32; shift += 8 )
+	{
+		const unsigned int from = ( color >> shift ) & 0xFF;
+		const unsigned int to = ( dest >> shift ) & 0xFF;
+
+		unsigned int value;
+		if( shift == alpha_source_shift )
+			value = ( from * c + to * inv_c + 127 ) / 255;
+		else
+			value = linear_to_srgb[ ( srgb_to_linear[ from ] * c + srgb_to_linear[ to ] * inv_c + 127 ) / 255 ];
+
+		result |= value << shift;
+	}
+
+	return SwapRedAndAlpha< PixelNative >( result );
+}
+
+unsigned int BlendPixel( unsigned int color, unsigned int dest, unsigned char coverage )
+{
+	if( blend_space == BLEND_LINEAR )
+		return BlendCoverageLinear( color, dest, coverage );
+
+	return BlendCoverage( color, dest, coverage );
+}
+
+void BlendCoverageSpan( unsigned int* dest, const unsigned char* coverage, int count, unsigned int color )
+{
+	if( blend_space == BLEND_LINEAR )
+	{
+		BlendSpanLinear( dest, coverage, count, color );
+		return;
+	}
+
+	if( blend_span == NULL ) 
+		PickBlendKernel();
+
+	blend_span( dest, coverage, count, color );
+}
+
+void FillCoverageSpan( unsigned int* dest, int count, unsigned int color )
+{
+	// full coverage is the color with red and alpha swapped, except where the
+	// pixel already was the color
+	const unsigned int opaque = BlendCoverage( color, ~color, 255 );
+	for( int i = 0; i < count; ++i )
+		dest[ i ] = ( dest[ i ] == color ) ? color : opaque;
+}
+
+const char* GetBlendKernelName()
+{
+	if( blend_span_name == NULL ) 
+		PickBlendKernel();
+
+	return blend_span_name;
+}
+
+bool SetBlendKernel( const char* name )
+{
+	if( strcmp( name, "scalar" ) == 0 )
+	{
+		blend_span = BlendSpanScalar;
+		blend_span_name = "scalar";
+		return true;
+	}
+
+#ifdef CENG_BLEND_SSE2
+	if( strcmp( name, "sse2" ) == 0 )
+	{
+		blend_span = BlendSpanSSE2;
+		blend_span_name = "sse2";
+		return true;
+	}
+#endif
+
+#ifdef CENG_BLEND_AVX2
+	if( strcmp( name, "avx2" ) == 0 && HasAVX2() )
+	{
+		blend_span = BlendSpanAVX2;
+		blend_span_name = "avx2";
+		return true;
+	}
+#endif
+
+	return false;
+}
+
+} // end of namespace ceng
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Coverage blending
+// =================
+//
+// Blends a solid color into 32 bit pixels by 8 bit coverage, the way text
+// gets drawn. BlendPixel() does one pixel, BlendCoverageSpan() a whole
+// row at a time with SSE2, or AVX2 when the cpu has it (picked on the
+// first call).
+//
+// Blending happens either straight on the stored 8 bit values (the default,
+// what has always been done) or in linear light, which keeps anti-aliased
+// edges from looking too thin and dark. Linear light goes through a 256
+// entry sRGB -> linear and a 4096 entry linear -> sRGB table, built once.
+//
+// Red and alpha of a blended pixel trade places, which is what the old
+// float CastToColor() did and what the foreground colors are written for.
+// The pixels are PixelNative. Red and alpha are its outermost bytes in
+// either byte order, which the SIMD kernels rely on.
+//
+//.............................................................................
+#ifndef INC_CBLEND_H
+#define INC_CBLEND_H
+
+#include "cpixelformat.h"
+
+namespace ceng {
+
+enum BlendSpace
+{
+	BLEND_GAMMA,		// on the stored values
+	BLEND_LINEAR		// in linear light, alpha is blended as is
+};
+
+//! how all of the blending below is done from now on
+void SetBlendSpace( BlendSpace space );
+BlendSpace GetBlendSpace();
+
+template< class Format >
+CENG_CONSTEXPR uint32 SwapRedAndAlpha( uint32 pixel )
+{
+	return Format::Pack( Format::GetA( pixel ), Format::GetG( pixel ), Format::GetB( pixel ), Format::GetR( pixel ) );
+}
+
+//! color over dest by coverage / 255 per channel, rounded. dest is returned
+//! as is if it already is color
+inline unsigned int BlendCoverage( unsigned int color, unsigned int dest, unsigned char coverage )
+{
+	if( color == dest ) return dest;
+
+	const unsigned int c = coverage;
+	const unsigned int inv_c = 255 - c;
+
+	// two channels at a time, each gets 16 bits which is enough for 255 * 255
+	unsigned int rb = ( color & 0x00FF00FF ) * c + ( dest & 0x00FF00FF ) * inv_c + 0x00800080;
+	unsigned int ga = ( ( color >> 8 ) & 0x00FF00FF ) * c + ( ( dest >> 8 ) & 0x00FF00FF ) * inv_c + 0x00800080;
+
+	// ( n + 127 ) / 255 for every 16 bit lane
+	rb = ( ( rb + ( ( rb >> 8 ) & 0x00FF00FF ) ) >> 8 ) & 0x00FF00FF;
+	ga = ( ga + ( ( ga >> 8 ) & 0x00FF00FF ) ) & 0xFF00FF00;
+
+	return SwapRedAndAlpha< PixelNative >( rb | ga );
+}
+
+//! BlendCoverage() in linear light
+unsigned int BlendCoverageLinear( unsigned int color, unsigned int dest, unsigned char coverage );
+
+//! BlendCoverage() or BlendCoverageLinear(), depending on the blend space
+unsigned int BlendPixel( unsigned int color, unsigned int dest, unsigned char coverage );
+
+//! BlendPixel() for count pixels. Pixels with zero coverage are left alone
+void BlendCoverageSpan( unsigned int* dest, const unsigned char* coverage, int count, unsigned int color );
+
+//! BlendPixel() at full coverage for count pixels, which needs no blending
+void FillCoverageSpan( unsigned int* dest, int count, unsigned int color );
+
+//! "avx2", "sse2" or "scalar", whichever BlendCoverageSpan() ended up using
+//! for BLEND_GAMMA. Linear light is always blended by the scalar code
+const char* GetBlendKernelName();
+
+//! has BlendCoverageSpan() use the named kernel from now on, so they can be
+//! checked against each other. False and nothing changed if this build or
+//! cpu doesn't have it
+bool SetBlendKernel( const char* name );
+
+} // end of namespace ceng
+
+#endif
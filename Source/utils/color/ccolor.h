@@ -34,6 +34,8 @@
 
 #include <math.h>
 
+#include "cpixelformat.h"
+
 //! Color class
 /*! A basic color class that thinks that each color component is a 8 bit integer
 	between [0 - 255]
@@ -54,7 +56,8 @@ public:
 	typedef unsigned int uint32;
 	typedef unsigned char uint8;
 
-	static void InitMasks();
+	// the masks are compile time constants now, see CPixelFormat
+	static void InitMasks() { }
 
 	CColorFloat( float r = 0, float g = 0, float b = 0, float a = 1.f ) :
 		r( r ),
@@ -291,20 +294,16 @@ public:
 	float	a;	/*!<	The alpha component of this color	*/
 
 	bool multiplied_with_alpha;
-private:
-
-	static bool masks_initialized;
-
 public:
-	static uint32	RMask;
-	static uint32	GMask;
-	static uint32	BMask;
-	static uint32	AMask;
+	static const uint32	RMask = PixelNative::r_mask;
+	static const uint32	GMask = PixelNative::g_mask;
+	static const uint32	BMask = PixelNative::b_mask;
+	static const uint32	AMask = PixelNative::a_mask;
 	
-	static uint8  RShift;
-	static uint8  GShift;
-	static uint8  BShift;
-	static uint8  AShift;
+	static const uint8  RShift = PixelNative::r_shift;
+	static const uint8  GShift = PixelNative::g_shift;
+	static const uint8  BShift = PixelNative::b_shift;
+	static const uint8  AShift = PixelNative::a_shift;
 	
 };
 
@@ -316,7 +315,8 @@ public:
 
 	typedef unsigned int uint32;
 	typedef unsigned char uint8;
-	static void InitMasks();
+	// the masks are compile time constants now, see CPixelFormat
+	static void InitMasks() { }
 
 	CColorUint8( uint8 r = 0, uint8 g = 0, uint8 b = 0, uint8 a = 255 ) :
 		r( r ),
@@ -539,20 +539,16 @@ public:
 	uint8	b;	/*!<	The blue component of this color	*/
 	uint8	a;	/*!<	The alpha component of this color	*/
 
-private:
-
-	static bool masks_initialized;
 public:
-
-	static uint32	RMask;
-	static uint32	GMask;
-	static uint32	BMask;
-	static uint32	AMask;
-	
-	static uint8  RShift;
-	static uint8  GShift;
-	static uint8  BShift;
-	static uint8  AShift;
+	static const uint32	RMask = PixelNative::r_mask;
+	static const uint32	GMask = PixelNative::g_mask;
+	static const uint32	BMask = PixelNative::b_mask;
+	static const uint32	AMask = PixelNative::a_mask;
+	
+	static const uint8  RShift = PixelNative::r_shift;
+	static const uint8  GShift = PixelNative::g_shift;
+	static const uint8  BShift = PixelNative::b_shift;
+	static const uint8  AShift = PixelNative::a_shift;
 	
 };
 
@@ -0,0 +1,155 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CPixelFormat
+// ============
+//
+// Compile time description of how a pixel is laid out in memory: which byte
+// holds which channel and how many bytes there are. Pack() and the Get*()
+// functions work on the pixel read from memory as one (native endian)
+// integer, so with the format known at compile time all the shifting folds
+// into constants and converting between equal formats becomes a copy.
+//
+// The 32 bit pixels the images are kept in are PixelNative, bytes in memory
+// in R, G, B, A order. The byte order of the machine is worked out from the
+// compiler's predefined macros, there's no need for SDL to tell it.
+//
+//.............................................................................
+#ifndef INC_CPIXELFORMAT_H
+#define INC_CPIXELFORMAT_H
+
+#include <string.h>
+
+#if defined( __BYTE_ORDER__ ) && defined( __ORDER_BIG_ENDIAN__ )
+#	if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#		define CENG_BIG_ENDIAN 1
+#	endif
+#elif defined( __BIG_ENDIAN__ ) || defined( __ARMEB__ ) || defined( __MIPSEB__ ) || defined( _M_PPC )
+#	define CENG_BIG_ENDIAN 1
+#endif
+
+#ifndef CENG_BIG_ENDIAN
+#	define CENG_BIG_ENDIAN 0
+#endif
+
+#if __cplusplus >= 201103L || ( defined( _MSC_VER ) && _MSC_VER >= 1900 )
+#	define CENG_CONSTEXPR constexpr
+#else
+#	define CENG_CONSTEXPR inline
+#endif
+
+namespace ceng {
+
+typedef unsigned int	uint32;
+typedef unsigned char	uint8;
+
+//! RByte..AByte are byte offsets inside the pixel, -1 for a channel the
+//! format doesn't have. Missing color channels read as 0, missing alpha as
+//! 255
+template< int RByte, int GByte, int BByte, int AByte, int Bytes >
+struct CPixelFormat
+{
+	enum
+	{
+		bytes_per_pixel = Bytes,
+
+		r_shift = ( RByte < 0 ) ? 0 : 8 * ( CENG_BIG_ENDIAN ? Bytes - 1 - RByte : RByte ),
+		g_shift = ( GByte < 0 ) ? 0 : 8 * ( CENG_BIG_ENDIAN ? Bytes - 1 - GByte : GByte ),
+		b_shift = ( BByte < 0 ) ? 0 : 8 * ( CENG_BIG_ENDIAN ? Bytes - 1 - BByte : BByte ),
+		a_shift = ( AByte < 0 ) ? 0 : 8 * ( CENG_BIG_ENDIAN ? Bytes - 1 - AByte : AByte )
+	};
+
+	static const uint32 r_mask = ( RByte < 0 ) ? 0 : 0xFFu << r_shift;
+	static const uint32 g_mask = ( GByte < 0 ) ? 0 : 0xFFu << g_shift;
+	static const uint32 b_mask = ( BByte < 0 ) ? 0 : 0xFFu << b_shift;
+	static const uint32 a_mask = ( AByte < 0 ) ? 0 : 0xFFu << a_shift;
+
+	static CENG_CONSTEXPR uint32 Pack( uint8 r, uint8 g, uint8 b, uint8 a )
+	{
+		return ( ( RByte < 0 ) ? 0 : (uint32)r << r_shift ) |
+			( ( GByte < 0 ) ? 0 : (uint32)g << g_shift ) |
+			( ( BByte < 0 ) ? 0 : (uint32)b << b_shift ) |
+			( ( AByte < 0 ) ? 0 : (uint32)a << a_shift );
+	}
+
+	static CENG_CONSTEXPR uint8 GetR( uint32 pixel ) { return ( RByte < 0 ) ? 0 : (uint8)( pixel >> r_shift ); }
+	static CENG_CONSTEXPR uint8 GetG( uint32 pixel ) { return ( GByte < 0 ) ? 0 : (uint8)( pixel >> g_shift ); }
+	static CENG_CONSTEXPR uint8 GetB( uint32 pixel ) { return ( BByte < 0 ) ? 0 : (uint8)( pixel >> b_shift ); }
+	static CENG_CONSTEXPR uint8 GetA( uint32 pixel ) { return ( AByte < 0 ) ? 255 : (uint8)( pixel >> a_shift ); }
+
+	//! the pixel at p as one integer
+	static inline uint32 Load( const uint8* p )
+	{
+		uint32 result = 0;
+		for( int i = 0; i < Bytes; ++i )
+			result |= (uint32)p[ i ] << ( 8 * ( CENG_BIG_ENDIAN ? Bytes - 1 - i : i ) );
+		return result;
+	}
+
+	static inline void Store( uint32 pixel, uint8* p )
+	{
+		for( int i = 0; i < Bytes; ++i )
+			p[ i ] = (uint8)( pixel >> ( 8 * ( CENG_BIG_ENDIAN ? Bytes - 1 - i : i ) ) );
+	}
+};
+
+template< int RByte, int GByte, int BByte, int AByte, int Bytes > const uint32 CPixelFormat< RByte, GByte, BByte, AByte, Bytes >::r_mask;
+template< int RByte, int GByte, int BByte, int AByte, int Bytes > const uint32 CPixelFormat< RByte, GByte, BByte, AByte, Bytes >::g_mask;
+template< int RByte, int GByte, int BByte, int AByte, int Bytes > const uint32 CPixelFormat< RByte, GByte, BByte, AByte, Bytes >::b_mask;
+template< int RByte, int GByte, int BByte, int AByte, int Bytes > const uint32 CPixelFormat< RByte, GByte, BByte, AByte, Bytes >::a_mask;
+
+typedef CPixelFormat< 0, 1, 2, 3, 4 >		PixelRGBA8;
+typedef CPixelFormat< 2, 1, 0, 3, 4 >		PixelBGRA8;
+typedef CPixelFormat< -1, -1, -1, 0, 1 >	PixelA8;
+
+//! what CArray2D< uint32 > images hold
+typedef PixelRGBA8							PixelNative;
+
+//! value is true if A and B are the same format, data in A can then be
+//! used as B without converting it
+template< class A, class B > struct CSameFormat		{ enum { value = false }; };
+template< class A > struct CSameFormat< A, A >		{ enum { value = true }; };
+
+//-----------------------------------------------------------------------------
+
+template< class From, class To >
+CENG_CONSTEXPR uint32 ConvertPixel( uint32 pixel )
+{
+	return To::Pack( From::GetR( pixel ), From::GetG( pixel ), From::GetB( pixel ), From::GetA( pixel ) );
+}
+
+template< class From, class To >
+struct CRowConverter
+{
+	static inline void Convert( const void* src, void* dest, int count )
+	{
+		const uint8* s = (const uint8*)src;
+		uint8* d = (uint8*)dest;
+		for( int i = 0; i < count; ++i )
+		{
+			To::Store( ConvertPixel< From, To >( From::Load( s ) ), d );
+			s += From::bytes_per_pixel;
+			d += To::bytes_per_pixel;
+		}
+	}
+};
+
+// nothing to shuffle between equal formats
+template< class Format >
+struct CRowConverter< Format, Format >
+{
+	static inline void Convert( const void* src, void* dest, int count )
+	{
+		memcpy( dest, src, count * Format::bytes_per_pixel );
+	}
+};
+
+//! count pixels from src in format From to dest in format To
+template< class From, class To >
+inline void ConvertRow( const void* src, void* dest, int count )
+{
+	CRowConverter< From, To >::Convert( src, dest, count );
+}
+
+} // end of namespace ceng
+
+#endif
@@ -0,0 +1,180 @@
+#include "cmappedfile.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+namespace ceng {
+
+CMappedFile::CMappedFile() :
+	myData( NULL ),
+	mySize( 0 ),
+	myMapped( false ),
+	myBuffer()
+#ifdef _WIN32
+	, myFileHandle( NULL ),
+	myMappingHandle( NULL )
+#endif
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open( const std::string& filename )
+{
+	Close();
+
+	if( Map( filename ) )
+		return true;
+
+	return Read( filename );
+}
+
+bool CMappedFile::Read( const std::string& filename )
+{
+	Close();
+
+	FILE* fptr = fopen( filename.c_str(), "rb" );
+	if( fptr == NULL )
+		return false;
+
+	fseek( fptr, 0, SEEK_END );
+	long size = ftell( fptr );
+	fseek( fptr, 0, SEEK_SET );
+
+	if( size <= 0 )
+	{
+		fclose( fptr );
+		return false;
+	}
+
+	myBuffer.resize( (size_t)size );
+	size_t read = fread( &myBuffer[0], 1, (size_t)size, fptr );
+	fclose( fptr );
+
+	if( read != (size_t)size )
+	{
+		myBuffer.clear();
+		return false;
+	}
+
+	myData = &myBuffer[0];
+	mySize = myBuffer.size();
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if( myMapped )
+		Unmap();
+
+	myBuffer.clear();
+	myData = NULL;
+	mySize = 0;
+	myMapped = false;
+}
+
+//-----------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+bool CMappedFile::Map( const std::string& filename )
+{
+	// FILE_SHARE_DELETE lets a newer version replace the file while it's
+	// mapped here, the mapping keeps seeing the old one
+	HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if( GetFileSizeEx( file, &size ) == 0 || size.QuadPart <= 0 )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( mapping == NULL )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( view == NULL )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+
+	myFileHandle = file;
+	myMappingHandle = mapping;
+	myData = (const unsigned char*)view;
+	mySize = (size_t)size.QuadPart;
+	myMapped = true;
+	return true;
+}
+
+void CMappedFile::Unmap()
+{
+	UnmapViewOfFile( myData );
+	CloseHandle( (HANDLE)myMappingHandle );
+	CloseHandle( (HANDLE)myFileHandle );
+	myMappingHandle = NULL;
+	myFileHandle = NULL;
+}
+
+#else
+
+bool CMappedFile::Map( const std::string& filename )
+{
+	int fd = open( filename.c_str(), O_RDONLY );
+	if( fd < 0 )
+		return false;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || st.st_size <= 0 )
+	{
+		close( fd );
+		return false;
+	}
+
+	void* view = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+	// the mapping keeps the file alive on its own
+	close( fd );
+
+	if( view == MAP_FAILED )
+		return false;
+
+	myData = (const unsigned char*)view;
+	mySize = (size_t)st.st_size;
+	myMapped = true;
+	return true;
+}
+
+void CMappedFile::Unmap()
+{
+	munmap( (void*)myData, mySize );
+}
+
+#endif
+
+} // end of namespace ceng
@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CMappedFile
+// ===========
+//
+// Read-only view of a whole file. Memory maps the file when the platform
+// allows it, otherwise reads it into a buffer it owns. Either way GetData()
+// stays valid until Close() or destruction.
+//
+//.............................................................................
+#ifndef INC_CMAPPEDFILE_H
+#define INC_CMAPPEDFILE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace ceng {
+
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	//! maps the file, falls back to reading it into memory
+	bool Open( const std::string& filename );
+
+	//! reads the file into memory without trying to map it
+	bool Read( const std::string& filename );
+
+	void Close();
+
+	bool IsOpen() const		{ return myData != NULL; }
+	bool IsMapped() const	{ return myMapped; }
+
+	const unsigned char* GetData() const	{ return myData; }
+	size_t GetSize() const					{ return mySize; }
+
+private:
+	// not copyable, the mapping has one owner
+	CMappedFile( const CMappedFile& );
+	const CMappedFile& operator=( const CMappedFile& );
+
+	bool Map( const std::string& filename );
+	void Unmap();
+
+	const unsigned char*		myData;
+	size_t						mySize;
+	bool						myMapped;
+	std::vector< unsigned char > myBuffer;
+
+#ifdef _WIN32
+	void*						myFileHandle;
+	void*						myMappingHandle;
+#endif
+};
+
+} // end of namespace ceng
+
+#endif
@@ -0,0 +1,752 @@
+#include "cfont.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#	include <process.h>
+#	define CFONT_GETPID _getpid
+#else
+#	include <unistd.h>
+#	define CFONT_GETPID getpid
+#endif
+
+namespace ceng {
+
+int DecodeUTF8( const std::string& text, std::size_t& i )
+{
+	const unsigned char c = (unsigned char)text[ i++ ];
+	if( c < 0x80 )
+		return c;
+
+	int extra = 0;
+	int codepoint = 0;
+	if( ( c & 0xE0 ) == 0xC0 )		{ extra = 1; codepoint = c & 0x1F; }
+	else if( ( c & 0xF0 ) == 0xE0 )	{ extra = 2; codepoint = c & 0x0F; }
+	else if( ( c & 0xF8 ) == 0xF0 )	{ extra = 3; codepoint = c & 0x07; }
+	else 
+		return 0xFFFD;
+
+	for( int k = 0; k < extra; ++k )
+	{
+		if( i >= text.size() || ( (unsigned char)text[ i ] & 0xC0 ) != 0x80 )
+			return 0xFFFD;
+
+		codepoint = ( codepoint << 6 ) | ( (unsigned char)text[ i++ ] & 0x3F );
+	}
+
+	// RFC 3629: the shortest form only, no UTF-16 surrogates and nothing
+	// past U+10FFFF
+	static const int min_codepoint[] = { 0, 0x80, 0x800, 0x10000 };
+	if( codepoint < min_codepoint[ extra ] || 
+		( codepoint >= 0xD800 && codepoint <= 0xDFFF ) ||
+		codepoint > 0x10FFFF )
+		return 0xFFFD;
+
+	return codepoint;
+}
+
+//-----------------------------------------------------------------------------
+
+bool CFontSource::Open( const std::string& ttf_file )
+{
+	Close();
+
+	if( myFile.Open( ttf_file ) == false )
+		return false;
+
+	const int offset = stbtt_GetFontOffsetForIndex( myFile.GetData(), 0 );
+	if( offset < 0 || stbtt_InitFont( &myInfo, myFile.GetData(), offset ) == 0 )
+	{
+		Close();
+		return false;
+	}
+
+	myFilename = ttf_file;
+	myValid = true;
+	return true;
+}
+
+void CFontSource::Close()
+{
+	myFile.Close();
+	memset( &myInfo, 0, sizeof( myInfo ) );
+	myFilename.clear();
+	myValid = false;
+	myHash = 0;
+	myHashValid = false;
+}
+
+unsigned long long CFontSource::GetHash() const
+{
+	if( myHashValid == false )
+	{
+		// 64 bit FNV-1a
+		unsigned long long hash = 14695981039346656037ULL;
+		const unsigned char* data = GetData();
+		for( size_t i = 0; i < GetSize(); ++i )
+		{
+			hash ^= data[ i ];
+			hash *= 1099511628211ULL;
+		}
+
+		myHash = hash;
+		myHashValid = true;
+	}
+
+	return myHash;
+}
+
+void CFontSource::MeasureText( const std::string& text, float& out_width, float& out_height ) const
+{
+	out_width = 0;
+	out_height = 0;
+
+	if( myValid == false )
+		return;
+
+	int width = 0;
+	int top = 0;
+	int bottom = 0;
+	int previous = -1;
+	for( std::size_t i = 0; i < text.size(); )
+	{
+		const int codepoint = DecodeUTF8( text, i );
+		if( codepoint < 32 || codepoint == 127 )
+			continue;
+
+		int advance = 0;
+		int lsb = 0;
+		stbtt_GetCodepointHMetrics( &myInfo, codepoint, &advance, &lsb );
+		width += advance;
+
+		if( previous >= 0 )
+			width += stbtt_GetCodepointKernAdvance( &myInfo, previous, codepoint );
+		previous = codepoint;
+
+		int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+		if( stbtt_GetCodepointBox( &myInfo, codepoint, &x0, &y0, &x1, &y1 ) )
+		{
+			top = std::max( top, y1 );
+			bottom = std::min( bottom, y0 );
+		}
+	}
+
+	out_width = (float)width;
+	out_height = (float)( top - bottom );
+}
+
+float CFontSource::FitTextSize( const std::string& text, float width, float height, float min_size, float max_size ) const
+{
+	cassert( min_size <= max_size );
+
+	float units_width = 0;
+	float units_height = 0;
+	MeasureText( text, units_width, units_height );
+
+	if( units_width <= 0 )
+		return max_size;
+
+	// the extent is linear in the scale, so every probe is a multiply
+	int low = (int)ceil( min_size );
+	int high = (int)floor( max_size );
+	int best = low;
+	while( low <= high )
+	{
+		const int middle = ( low + high ) / 2;
+		const float scale = stbtt_ScaleForPixelHeight( &myInfo, (float)middle );
+		if( units_width * scale <= width && units_height * scale <= height )
+		{
+			best = middle;
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+
+	// there might not be a whole size between them, ceil( min_size ) is
+	// then already past max_size
+	return std::min( (float)best, max_size );
+}
+
+//-----------------------------------------------------------------------------
+
+void CFontAtlas::Resize( int width, int height )
+{
+	myBitmap.ResizeUninitialized( width, height );
+	myBitmap.SetEverythingTo( 0 );
+	myPixels = myBitmap.GetData().data;
+	myWidth = width;
+	myHeight = height;
+}
+
+void CFontAtlas::Grow( int height )
+{
+	if( height <= myHeight )
+		return;
+
+	if( myPixels == NULL )
+	{
+		Resize( max_width, height );
+		return;
+	}
+
+	// rows are contiguous and the width doesn't change, so the old content
+	// is just the beginning of the new buffer
+	CArray2D< unsigned char > old_bitmap;
+	const unsigned char* old_pixels = myPixels;
+	if( IsExternal() == false )
+	{
+		old_bitmap.Swap( myBitmap );
+		old_pixels = old_bitmap.GetData().data;
+	}
+
+	const int old_height = myHeight;
+	Resize( myWidth, height );
+	memcpy( myBitmap.GetData().data, old_pixels, myWidth * old_height );
+}
+
+void CFontAtlas::SetExternal( const unsigned char* pixels, int width, int height )
+{
+	Clear();
+	myPixels = pixels;
+	myWidth = width;
+	myHeight = height;
+}
+
+void CFontAtlas::Clear()
+{
+	myBitmap.Clear();
+	myPixels = NULL;
+	myWidth = 0;
+	myHeight = 0;
+}
+
+unsigned char* CFontAtlas::GetPixels()
+{
+	// never write into someone else's buffer, take a copy first
+	if( IsExternal() )
+	{
+		const unsigned char* external = myPixels;
+		const int width = myWidth;
+		const int height = myHeight;
+		myBitmap.ResizeUninitialized( width, height );
+		memcpy( myBitmap.GetData().data, external, width * height );
+		myPixels = myBitmap.GetData().data;
+	}
+
+	return myBitmap.GetData().data;
+}
+
+void CFontAtlas::EstimateSize( int num_chars, float size, int& out_width, int& out_height )
+{
+	// a glyph box is roughly size x size at most, stb leaves a 1 pixel gap
+	// around each one
+	const int cell = (int)( size + 0.5f ) + 2;
+	const int wanted_per_row = (int)ceil( sqrt( (float)num_chars ) );
+
+	out_width = 64;
+	while( out_width < wanted_per_row * cell && out_width < max_width )
+		out_width *= 2;
+
+	const int per_row = std::max( 1, out_width / cell );
+	const int rows = ( num_chars + per_row - 1 ) / per_row;
+	out_height = rows * cell + 2;
+}
+
+//-----------------------------------------------------------------------------
+
+void CFont::Clear()
+{
+	myAtlas.Clear();
+	myCacheFile.Close();
+	myCharQuads.clear();
+	myExtraGlyphs.clear();
+	mySubpixelGlyphs.clear();
+	myKerning.clear();
+	mySource = NULL;
+	mySize = 0;
+	myScale = 0;
+	myFirstChar = 0;
+	myNumChars = 0;
+	myPackX = 0;
+	myPackY = 0;
+	myPackBottom = 0;
+}
+
+void CFont::ResetPacking( const CFontSource& source )
+{
+	mySource = &source;
+	myScale = stbtt_ScaleForPixelHeight( &source.GetInfo(), mySize );
+
+	// stb leaves one empty pixel around every glyph, keep doing the same
+	int bottom = 1;
+	for( int i = 0; i < myNumChars; ++i )
+	{
+		const CharQuad& quad = myCharQuads[ i + myFirstChar ];
+		bottom = std::max( bottom, (int)( quad.rect.y + quad.rect.h ) + 1 );
+	}
+
+	myPackX = 1;
+	myPackY = bottom;
+	myPackBottom = bottom;
+}
+
+const CharQuad* CFont::GetGlyph( int codepoint )
+{
+	if( codepoint < 32 || codepoint == 127 )
+		return NULL;
+
+	if( HasChar( codepoint ) )
+		return &myCharQuads[ codepoint ];
+
+	std::map< int, CharQuad >::const_iterator i = myExtraGlyphs.find( codepoint );
+	if( i != myExtraGlyphs.end() )
+		return &i->second;
+
+	return AddGlyph( codepoint );
+}
+
+const CharQuad* CFont::GetGlyph( int codepoint, int phase )
+{
+	if( phase <= 0 || phase >= subpixel_phases )
+		return GetGlyph( codepoint );
+
+	if( codepoint < 32 || codepoint == 127 )
+		return NULL;
+
+	const std::pair< int, int > key( codepoint, phase );
+	std::map< std::pair< int, int >, CharQuad >::const_iterator i = mySubpixelGlyphs.find( key );
+	if( i != mySubpixelGlyphs.end() )
+		return &i->second;
+
+	CharQuad quad;
+	if( RasterizeGlyph( codepoint, (float)phase / (float)subpixel_phases, quad ) == false )
+		return NULL;
+
+	return &( mySubpixelGlyphs[ key ] = quad );
+}
+
+const CharQuad* CFont::AddGlyph( int codepoint )
+{
+	CharQuad quad;
+	if( RasterizeGlyph( codepoint, 0, quad ) == false )
+		return NULL;
+
+	return &( myExtraGlyphs[ codepoint ] = quad );
+}
+
+bool CFont::RasterizeGlyph( int codepoint, float shift_x, CharQuad& out )
+{
+	if( mySource == NULL || mySource->IsValid() == false || myAtlas.GetWidth() <= 0 )
+		return false;
+
+	const stbtt_fontinfo* info = &mySource->GetInfo();
+	const float scale = myScale;
+
+	int advance = 0;
+	int lsb = 0;
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	stbtt_GetCodepointHMetrics( info, codepoint, &advance, &lsb );
+	stbtt_GetCodepointBitmapBoxSubpixel( info, codepoint, scale, scale, shift_x, 0, &x0, &y0, &x1, &y1 );
+
+	const int gw = x1 - x0;
+	const int gh = y1 - y0;
+	if( gw + 2 > myAtlas.GetWidth() )
+		return false;
+
+	// same shelf packing stbtt_BakeFontBitmap does
+	if( myPackX + gw + 1 >= myAtlas.GetWidth() )
+	{
+		myPackX = 1;
+		myPackY = myPackBottom;
+	}
+
+	if( myPackY + gh + 1 >= myAtlas.GetHeight() )
+	{
+		int height = std::max( myAtlas.GetHeight(), 1 );
+		while( myPackY + gh + 1 >= height )
+			height *= 2;
+		myAtlas.Grow( height );
+	}
+
+	unsigned char* pixels = myAtlas.GetPixels();
+	const int stride = myAtlas.GetWidth();
+	stbtt_MakeCodepointBitmapSubpixel( info, pixels + myPackX + myPackY * stride, gw, gh, stride, scale, scale, shift_x, 0, codepoint );
+
+	out = CharQuad( 
+		types::rect( (float)myPackX, (float)myPackY, (float)gw, (float)gh ),
+		types::vector2( (float)x0, (float)y0 ),
+		scale * advance );
+	out.height = mySize;
+
+	myPackX += gw + 2;
+	myPackBottom = std::max( myPackBottom, myPackY + gh + 2 );
+
+	return true;
+}
+
+void CFont::BuildKerning()
+{
+	myKerning.clear();
+
+	if( mySource == NULL || mySource->IsValid() == false || mySource->GetInfo().kern == 0 )
+		return;
+
+	const stbtt_fontinfo* info = &mySource->GetInfo();
+
+	// every pair lookup would map both codepoints through the cmap and then
+	// search the kern table, do the cmap part once per glyph
+	std::vector< int > glyph_index( myNumChars );
+	for( int i = 0; i < myNumChars; ++i )
+		glyph_index[ i ] = stbtt_FindGlyphIndex( info, myFirstChar + i );
+
+	myKerning.resize( myNumChars * myNumChars, 0 );
+
+	bool any_kerning = false;
+	for( int a = 0; a < myNumChars; ++a )
+	{
+		for( int b = 0; b < myNumChars; ++b )
+		{
+			const int kern = stbtt_GetGlyphKernAdvance( info, glyph_index[ a ], glyph_index[ b ] );
+			if( kern != 0 )
+			{
+				myKerning[ a * myNumChars + b ] = myScale * kern;
+				any_kerning = true;
+			}
+		}
+	}
+
+	if( any_kerning == false )
+		myKerning.clear();
+}
+
+float CFont::GetKerning( int c1, int c2 ) const
+{
+	if( HasChar( c1 ) && HasChar( c2 ) )
+	{
+		if( myKerning.empty() )
+			return 0;
+
+		return myKerning[ ( c1 - myFirstChar ) * myNumChars + ( c2 - myFirstChar ) ];
+	}
+
+	// outside the baked range, rare enough to just look it up
+	if( mySource == NULL || mySource->IsValid() == false )
+		return 0;
+
+	return myScale * stbtt_GetCodepointKernAdvance( &mySource->GetInfo(), c1, c2 );
+}
+
+bool CFont::Bake( const CFontSource& source, float size, int first_char, int num_chars )
+{
+	Clear();
+
+	if( source.IsValid() == false || num_chars <= 0 )
+		return false;
+
+	const unsigned char* ttf_data = source.GetData();
+	const int offset = source.GetOffset();
+
+	int width = 0;
+	int height = 0;
+	CFontAtlas::EstimateSize( num_chars, size, width, height );
+
+	std::vector< stbtt_bakedchar > cdata( num_chars );
+
+	myAtlas.Resize( width, height );
+	int result = stbtt_BakeFontBitmap( ttf_data, offset, size, myAtlas.GetPixels(), width, height, first_char, num_chars, &cdata[0] );
+
+	// the estimate was too small, stb has to start over so there's nothing to
+	// keep from the previous try
+	while( result <= 0 )
+	{
+		height *= 2;
+		if( height > 16 * CFontAtlas::max_width )
+		{
+			Clear();
+			return false;
+		}
+
+		myAtlas.Resize( width, height );
+		result = stbtt_BakeFontBitmap( ttf_data, offset, size, myAtlas.GetPixels(), width, height, first_char, num_chars, &cdata[0] );
+	}
+
+	myCharQuads.resize( first_char + num_chars );
+
+	for( int i = 0; i < num_chars; ++i )
+	{
+		myCharQuads[ i + first_char ] = CharQuad(
+				types::rect(
+					(float)cdata[ i ].x0,
+					(float)cdata[ i ].y0,
+					(float)(cdata[ i ].x1 - cdata[ i ].x0),
+					(float)(cdata[ i ].y1 - cdata[ i ].y0) ),
+				types::vector2(
+					cdata[ i ].xoff,
+					cdata[ i ].yoff ),
+				cdata[ i ].xadvance );
+
+		myCharQuads[ i + first_char ].height = size;
+	}
+
+	mySize = size;
+	myFirstChar = first_char;
+	myNumChars = num_chars;
+	ResetPacking( source );
+	BuildKerning();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// font cache files
+//
+// header, one FontCacheGlyph per baked char, the kerning table (if the font
+// has kerning) and then the atlas pixels. Only ever read back on the machine
+// that wrote it, so it is in native byte order
+
+namespace {
+
+const unsigned int font_cache_magic = 0x43544E46;	// "FNTC"
+const unsigned int font_cache_version = 2;
+
+struct FontCacheHeader
+{
+	unsigned int	magic;
+	unsigned int	version;
+	unsigned int	hash_low;
+	unsigned int	hash_high;
+	float			size;
+	int				first_char;
+	int				num_chars;
+	int				atlas_width;
+	int				atlas_height;
+	unsigned int	glyph_record_size;
+	int				kerning_count;		// 0 or num_chars * num_chars floats
+};
+
+struct FontCacheGlyph
+{
+	float x, y, w, h;
+	float offset_x, offset_y;
+	float width;
+	float height;
+};
+
+// the glyph's rectangle is inside the atlas. Written so that a NaN fails
+// every test, a broken file can have anything in it
+bool IsInsideAtlas( const FontCacheGlyph& g, int atlas_width, int atlas_height )
+{
+	return 
+		g.x >= 0 && g.y >= 0 && g.w >= 0 && g.h >= 0 &&
+		g.x + g.w <= (float)atlas_width &&
+		g.y + g.h <= (float)atlas_height;
+}
+
+}
+
+std::string CFont::GetCacheFilename( const std::string& cache_dir, const CFontSource& source, float size, int first_char, int num_chars )
+{
+	std::stringstream ss;
+	ss << cache_dir;
+	if( cache_dir.empty() == false && cache_dir[ cache_dir.size() - 1 ] != '/' && cache_dir[ cache_dir.size() - 1 ] != '\\' )
+		ss << "/";
+
+	ss << std::hex << std::setw( 16 ) << std::setfill( '0' ) << source.GetHash() << std::dec;
+	// the bits of the size, so that sizes that print the same still get
+	// files of their own
+	unsigned int size_bits = 0;
+	memcpy( &size_bits, &size, sizeof( size_bits ) );
+	ss << "_" << std::hex << std::setw( 8 ) << size_bits << std::dec;
+	ss << "_" << first_char << "_" << num_chars << ".fontcache";
+	return ss.str();
+}
+
+bool CFont::LoadCache( const std::string& cache_file, const CFontSource& source, float size, int first_char, int num_chars )
+{
+	Clear();
+
+	if( source.IsValid() == false || myCacheFile.Open( cache_file ) == false )
+		return false;
+
+	const unsigned char* data = myCacheFile.GetData();
+	const size_t header_size = sizeof( FontCacheHeader );
+	if( myCacheFile.GetSize() < header_size )
+	{
+		Clear();
+		return false;
+	}
+
+	FontCacheHeader header;
+	memcpy( &header, data, header_size );
+
+	const unsigned long long hash = source.GetHash();
+	if( header.magic != font_cache_magic ||
+		header.version != font_cache_version ||
+		header.hash_low != (unsigned int)( hash & 0xFFFFFFFF ) ||
+		header.hash_high != (unsigned int)( hash >> 32 ) ||
+		header.size != size ||
+		header.first_char != first_char ||
+		header.num_chars != num_chars ||
+		header.glyph_record_size != sizeof( FontCacheGlyph ) ||
+		( header.kerning_count != 0 && header.kerning_count != num_chars * num_chars ) ||
+		header.atlas_width <= 0 || 
+		header.atlas_height <= 0 )
+	{
+		Clear();
+		return false;
+	}
+
+	const size_t glyphs_size = (size_t)num_chars * sizeof( FontCacheGlyph );
+	const size_t kerning_size = (size_t)header.kerning_count * sizeof( float );
+	const size_t atlas_size = (size_t)header.atlas_width * (size_t)header.atlas_height;
+	if( myCacheFile.GetSize() != header_size + glyphs_size + kerning_size + atlas_size )
+	{
+		Clear();
+		return false;
+	}
+
+	const FontCacheGlyph* glyphs = (const FontCacheGlyph*)( data + header_size );
+
+	// the right size doesn't mean the right content, a rectangle outside the
+	// atlas would have the blitters read past the end of the mapped file
+	for( int i = 0; i < num_chars; ++i )
+	{
+		if( IsInsideAtlas( glyphs[ i ], header.atlas_width, header.atlas_height ) == false )
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	myCharQuads.resize( first_char + num_chars );
+	for( int i = 0; i < num_chars; ++i )
+	{
+		const FontCacheGlyph& g = glyphs[ i ];
+		myCharQuads[ i + first_char ] = CharQuad( 
+			types::rect( g.x, g.y, g.w, g.h ),
+			types::vector2( g.offset_x, g.offset_y ),
+			g.width );
+		myCharQuads[ i + first_char ].height = g.height;
+	}
+
+	// the table was built when the font was baked, no pair lookups here
+	myKerning.resize( header.kerning_count );
+	if( header.kerning_count > 0 )
+		memcpy( &myKerning[0], data + header_size + glyphs_size, kerning_size );
+
+	myAtlas.SetExternal( data + header_size + glyphs_size + kerning_size, header.atlas_width, header.atlas_height );
+
+	mySize = size;
+	myFirstChar = first_char;
+	myNumChars = num_chars;
+	ResetPacking( source );
+
+	return true;
+}
+
+bool CFont::SaveCache( const std::string& cache_file, const CFontSource& source ) const
+{
+	if( source.IsValid() == false || myAtlas.GetPixels() == NULL || myNumChars <= 0 )
+		return false;
+
+	const unsigned long long hash = source.GetHash();
+
+	FontCacheHeader header;
+	header.magic = font_cache_magic;
+	header.version = font_cache_version;
+	header.hash_low = (unsigned int)( hash & 0xFFFFFFFF );
+	header.hash_high = (unsigned int)( hash >> 32 );
+	header.size = mySize;
+	header.first_char = myFirstChar;
+	header.num_chars = myNumChars;
+	header.atlas_width = myAtlas.GetWidth();
+	header.atlas_height = myAtlas.GetHeight();
+	header.glyph_record_size = sizeof( FontCacheGlyph );
+	header.kerning_count = (int)myKerning.size();
+
+	std::vector< FontCacheGlyph > glyphs( myNumChars );
+	for( int i = 0; i < myNumChars; ++i )
+	{
+		const CharQuad& quad = myCharQuads[ i + myFirstChar ];
+		glyphs[ i ].x = quad.rect.x;
+		glyphs[ i ].y = quad.rect.y;
+		glyphs[ i ].w = quad.rect.w;
+		glyphs[ i ].h = quad.rect.h;
+		glyphs[ i ].offset_x = quad.offset.x;
+		glyphs[ i ].offset_y = quad.offset.y;
+		glyphs[ i ].width = quad.width;
+		glyphs[ i ].height = quad.height;
+	}
+
+	// other processes may be reading the cache at the same time, so write
+	// to a temporary file and move it in place when it's complete
+	std::stringstream temp_file;
+	temp_file << cache_file << "." << CFONT_GETPID() << ".tmp";
+
+	FILE* fptr = fopen( temp_file.str().c_str(), "wb" );
+	if( fptr == NULL )
+		return false;
+
+	const size_t atlas_size = (size_t)header.atlas_width * (size_t)header.atlas_height;
+	bool ok = 
+		fwrite( &header, sizeof( header ), 1, fptr ) == 1 &&
+		fwrite( &glyphs[0], sizeof( FontCacheGlyph ), glyphs.size(), fptr ) == glyphs.size() &&
+		( myKerning.empty() || fwrite( &myKerning[0], sizeof( float ), myKerning.size(), fptr ) == myKerning.size() ) &&
+		fwrite( myAtlas.GetPixels(), 1, atlas_size, fptr ) == atlas_size;
+
+	if( fclose( fptr ) != 0 )
+		ok = false;
+
+#ifdef _WIN32
+	// rename doesn't replace an existing file on windows. This does, also
+	// while someone has the old one mapped (CMappedFile shares it for
+	// deleting). If it still can't, the old file just stays
+	if( ok && MoveFileExA( temp_file.str().c_str(), cache_file.c_str(), MOVEFILE_REPLACE_EXISTING ) == 0 )
+		ok = false;
+#else
+	if( ok && rename( temp_file.str().c_str(), cache_file.c_str() ) != 0 )
+		ok = false;
+#endif
+
+	if( ok == false )
+	{
+		remove( temp_file.str().c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+bool CFont::BakeCached( const CFontSource& source, float size, const std::string& cache_dir, int first_char, int num_chars )
+{
+	if( cache_dir.empty() || source.IsValid() == false )
+		return Bake( source, size, first_char, num_chars );
+
+	const std::string cache_file = GetCacheFilename( cache_dir, source, size, first_char, num_chars );
+	if( LoadCache( cache_file, source, size, first_char, num_chars ) )
+		return true;
+
+	if( Bake( source, size, first_char, num_chars ) == false )
+		return false;
+
+	// the cache is only there to save time, not being able to write it is fine
+	SaveCache( cache_file, source );
+	return true;
+}
+
+} // end of namespace ceng
@@ -0,0 +1,240 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CFont
+// =====
+//
+// A baked font. Owns the glyph atlas (the coverage bitmap the glyphs are
+// packed into) and the CharQuad table that tells where each glyph lives in
+// it.
+//
+// The atlas is sized from the glyph set and pixel size that are requested,
+// and only grows if the estimate was too small. It used to be a static
+// 4096 x 20480 buffer that got cleared on every bake.
+//
+//.............................................................................
+#ifndef INC_CFONT_H
+#define INC_CFONT_H
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../array2d/carray2d.h"
+#include "../math/cvector2.h"
+#include "../math/crect.h"
+#include "../filesystem/cmappedfile.h"
+
+// the implementation part of stb_truetype isn't include guarded
+#ifndef __STB_INCLUDE_STB_TRUETYPE_H__
+#include "../../stb/stb_truetype.h"
+#endif
+
+namespace ceng {
+
+struct CharQuad
+{
+	CharQuad() : rect(), offset(), width( 0 ), height( 0 ) { }
+	CharQuad( const types::rect& rect, const types::vector2& offset, float width ) : rect( rect ), offset( offset ), width( width ), height( 0 ) { }
+
+	types::rect			rect;
+	types::vector2		offset;
+	float				width;
+	float				height;
+
+};
+
+//! decodes the utf-8 sequence starting at text[ i ] and moves i past it.
+//! Malformed sequences come out as U+FFFD one byte at a time, overlong
+//! forms, surrogates and values past U+10FFFF as one U+FFFD each
+int DecodeUTF8( const std::string& text, std::size_t& i );
+
+//-----------------------------------------------------------------------------
+
+//! The ttf data fonts are baked from. The file stays mapped (or read into
+//! memory if it can't be mapped) for as long as the source is open.
+class CFontSource
+{
+public:
+	CFontSource() : myFile(), myInfo(), myFilename(), myValid( false ), myHash( 0 ), myHashValid( false ) { }
+
+	bool Open( const std::string& ttf_file );
+	void Close();
+
+	bool IsValid() const { return myValid; }
+
+	const unsigned char* GetData() const	{ return myFile.GetData(); }
+	size_t GetSize() const					{ return myFile.GetSize(); }
+	int GetOffset() const					{ return myInfo.fontstart; }
+
+	const stbtt_fontinfo& GetInfo() const	{ return myInfo; }
+	const std::string& GetFilename() const	{ return myFilename; }
+
+	//! hash of the file content, computed on first use
+	unsigned long long GetHash() const;
+
+	//! extent of text in font units (advances plus kerning by the tallest
+	//! glyph box) from the metrics alone, nothing gets rasterised
+	void MeasureText( const std::string& text, float& out_width, float& out_height ) const;
+
+	//! largest whole pixel size in [min_size, max_size] at which text fits
+	//! in width x height, min_size if it doesn't fit at all. Never more than
+	//! max_size, min_size can't be larger than it
+	float FitTextSize( const std::string& text, float width, float height, float min_size, float max_size ) const;
+
+private:
+	CMappedFile		myFile;
+	stbtt_fontinfo	myInfo;
+	std::string		myFilename;
+	bool			myValid;
+
+	mutable unsigned long long	myHash;
+	mutable bool				myHashValid;
+};
+
+//-----------------------------------------------------------------------------
+
+//! 8 bit coverage bitmap the glyphs are packed into. The pixels either live
+//! in the atlas itself or in a buffer someone else owns (a mapped font cache
+//! file), in which case they are copied over the first time they're written
+class CFontAtlas
+{
+public:
+	CFontAtlas() : myBitmap(), myPixels( NULL ), myWidth( 0 ), myHeight( 0 ) { }
+
+	//! discards the old content
+	void Resize( int width, int height );
+
+	//! makes the atlas taller, keeps what is already in it
+	void Grow( int height );
+
+	//! uses pixels without copying them, they have to outlive the atlas
+	void SetExternal( const unsigned char* pixels, int width, int height );
+	bool IsExternal() const { return myPixels != NULL && myBitmap.Empty(); }
+
+	void Clear();
+
+	int GetWidth() const	{ return myWidth; }
+	int GetHeight() const	{ return myHeight; }
+
+	unsigned char* GetPixels();
+	const unsigned char* GetPixels() const { return myPixels; }
+
+	inline unsigned char Rand( int x, int y ) const { return myPixels[ x + y * myWidth ]; }
+
+	//! the first pixel of row y
+	inline const unsigned char* Row( int y ) const { return myPixels + (ptrdiff_t)y * myWidth; }
+
+	//! guesses the atlas size needed for num_chars glyphs at pixel height size
+	static void EstimateSize( int num_chars, float size, int& out_width, int& out_height );
+
+	static const int max_width = 4096;
+
+private:
+	CArray2D< unsigned char >	myBitmap;
+	const unsigned char*		myPixels;
+	int							myWidth;
+	int							myHeight;
+};
+
+//-----------------------------------------------------------------------------
+
+class CFont
+{
+public:
+	CFont() : 
+		myAtlas(), 
+		myCharQuads(), 
+		myExtraGlyphs(),
+		mySubpixelGlyphs(),
+		myKerning(),
+		mySource( NULL ),
+		mySize( 0 ), 
+		myScale( 0 ),
+		myFirstChar( 0 ), 
+		myNumChars( 0 ), 
+		myPackX( 0 ),
+		myPackY( 0 ),
+		myPackBottom( 0 ),
+		myCacheFile() 
+	{ 
+	}
+
+	//! bakes glyphs [first_char, first_char + num_chars) from the source at
+	//! pixel height size, growing the atlas until everything fits
+	bool Bake( const CFontSource& source, float size, int first_char = 32, int num_chars = 95 );
+
+	//! like Bake() but goes through an on-disk cache in cache_dir. A cache
+	//! file that matches the font content, size and glyph range is mapped and
+	//! used as is, anything else gets baked and written back to the cache
+	bool BakeCached( const CFontSource& source, float size, const std::string& cache_dir, int first_char = 32, int num_chars = 95 );
+
+	//! returns false if the file is missing or doesn't match the request
+	bool LoadCache( const std::string& cache_file, const CFontSource& source, float size, int first_char, int num_chars );
+	bool SaveCache( const std::string& cache_file, const CFontSource& source ) const;
+
+	static std::string GetCacheFilename( const std::string& cache_dir, const CFontSource& source, float size, int first_char, int num_chars );
+
+	void Clear();
+
+	bool HasChar( int c ) const { return c >= myFirstChar && c < myFirstChar + myNumChars; }
+	const CharQuad& GetCharQuad( int c ) const { return myCharQuads[ c ]; }
+
+	//! glyph for a unicode codepoint. Codepoints outside the baked range are
+	//! rasterised into the atlas the first time they are asked for. NULL for
+	//! control characters or if the font has no source to rasterise from
+	const CharQuad* GetGlyph( int codepoint );
+
+	//! horizontal subpixel positions a glyph can be rasterised at
+	static const int subpixel_phases = 4;
+
+	//! the glyph shifted right by phase / subpixel_phases of a pixel. Phase 0
+	//! is the plain glyph, the other phases are rasterised into the atlas the
+	//! first time they are asked for and kept
+	const CharQuad* GetGlyph( int codepoint, int phase );
+
+	//! extra advance in pixels between c1 and c2. Pairs inside the baked
+	//! range come from a table built once at bake time
+	float GetKerning( int c1, int c2 ) const;
+
+	const CFontAtlas& GetAtlas() const { return myAtlas; }
+
+	float GetSize() const { return mySize; }
+
+private:
+	// continues packing below whatever the bake or the cache file put in
+	void ResetPacking( const CFontSource& source );
+
+	// dense num_chars x num_chars table of the baked range, left empty if
+	// the font has no kerning
+	void BuildKerning();
+
+	const CharQuad* AddGlyph( int codepoint );
+
+	// rasterises the glyph shifted by shift_x into the free part of the atlas
+	bool RasterizeGlyph( int codepoint, float shift_x, CharQuad& out );
+
+	CFontAtlas				myAtlas;
+	std::vector< CharQuad >	myCharQuads;
+	std::map< int, CharQuad > myExtraGlyphs;
+	std::map< std::pair< int, int >, CharQuad > mySubpixelGlyphs;
+	std::vector< float >	myKerning;
+	const CFontSource*		mySource;
+
+	float					mySize;
+	float					myScale;
+	int						myFirstChar;
+	int						myNumChars;
+
+	// shelf packer state for glyphs added after the bake
+	int						myPackX;
+	int						myPackY;
+	int						myPackBottom;
+
+	// keeps the atlas pixels alive when they come from a cache file
+	CMappedFile				myCacheFile;
+};
+
+} // end of namespace ceng
+
+#endif
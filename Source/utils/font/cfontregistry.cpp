@@ -0,0 +1,87 @@
+#include "cfontregistry.h"
+
+namespace ceng {
+
+CFont* CFontRegistry::GetFont( const std::string& ttf_file, float size )
+{
+	const FontMap::key_type key( ttf_file, size );
+
+	FontMap::iterator i = myFonts.find( key );
+	if( i != myFonts.end() )
+		return i->second;
+
+	CFontSource* source = GetSource( ttf_file );
+	if( source == NULL )
+		return NULL;
+
+	CFont* font = new CFont;
+	if( font->BakeCached( *source, size, myCacheDir ) == false )
+	{
+		delete font;
+		return NULL;
+	}
+
+	myFonts[ key ] = font;
+	return font;
+}
+
+CSDFFont* CFontRegistry::GetSDFFont( const std::string& ttf_file )
+{
+	SDFFontMap::iterator i = mySDFFonts.find( ttf_file );
+	if( i != mySDFFonts.end() )
+		return i->second;
+
+	CFontSource* source = GetSource( ttf_file );
+	if( source == NULL )
+		return NULL;
+
+	CSDFFont* font = new CSDFFont;
+	if( font->Bake( *source ) == false )
+	{
+		delete font;
+		return NULL;
+	}
+
+	mySDFFonts[ ttf_file ] = font;
+	return font;
+}
+
+CFontSource* CFontRegistry::GetSource( const std::string& ttf_file )
+{
+	SourceMap::iterator i = mySources.find( ttf_file );
+	if( i != mySources.end() )
+		return i->second;
+
+	CFontSource* source = new CFontSource;
+	if( source->Open( ttf_file ) == false )
+	{
+		delete source;
+		return NULL;
+	}
+
+	mySources[ ttf_file ] = source;
+	return source;
+}
+
+bool CFontRegistry::HasFont( const std::string& ttf_file, float size ) const
+{
+	return myFonts.find( FontMap::key_type( ttf_file, size ) ) != myFonts.end();
+}
+
+void CFontRegistry::Clear()
+{
+	for( FontMap::iterator i = myFonts.begin(); i != myFonts.end(); ++i )
+		delete i->second;
+	myFonts.clear();
+
+	for( SDFFontMap::iterator i = mySDFFonts.begin(); i != mySDFFonts.end(); ++i )
+		delete i->second;
+	mySDFFonts.clear();
+
+	// fonts may still point into the sources, so those go last
+	for( SourceMap::iterator i = mySources.begin(); i != mySources.end(); ++i )
+		delete i->second;
+	mySources.clear();
+}
+
+} // end of namespace ceng
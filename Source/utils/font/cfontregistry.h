@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CFontRegistry
+// =============
+//
+// Keeps every (ttf file, size) font that has been asked for baked and ready,
+// so a page can mix sizes and later jobs at the same size reuse the atlas.
+// Each ttf file is opened once and shared by all of its sizes. Distance
+// field fonts are size independent, there is one of those per file.
+//
+//.............................................................................
+#ifndef INC_CFONTREGISTRY_H
+#define INC_CFONTREGISTRY_H
+
+#include <map>
+#include <string>
+#include <utility>
+
+#include "cfont.h"
+#include "csdffont.h"
+
+namespace ceng {
+
+class CFontRegistry
+{
+public:
+	CFontRegistry() : mySources(), myFonts(), mySDFFonts(), myCacheDir() { }
+	~CFontRegistry() { Clear(); }
+
+	//! baked fonts get cached in here, empty disables the on-disk cache
+	void SetCacheDir( const std::string& cache_dir ) { myCacheDir = cache_dir; }
+	const std::string& GetCacheDir() const { return myCacheDir; }
+
+	//! returns the font baked from ttf_file at pixel height size, baking it
+	//! the first time it's asked for. NULL if the file can't be used
+	CFont* GetFont( const std::string& ttf_file, float size );
+
+	//! distance field font of ttf_file, built the first time it's asked for.
+	//! NULL if the file can't be used
+	CSDFFont* GetSDFFont( const std::string& ttf_file );
+
+	//! NULL if the file can't be opened
+	CFontSource* GetSource( const std::string& ttf_file );
+
+	bool HasFont( const std::string& ttf_file, float size ) const;
+
+	void Clear();
+
+private:
+	// not copyable, owns the fonts
+	CFontRegistry( const CFontRegistry& );
+	const CFontRegistry& operator=( const CFontRegistry& );
+
+	typedef std::map< std::string, CFontSource* >					SourceMap;
+	typedef std::map< std::pair< std::string, float >, CFont* >	FontMap;
+	typedef std::map< std::string, CSDFFont* >						SDFFontMap;
+
+	SourceMap		mySources;
+	FontMap			myFonts;
+	SDFFontMap		mySDFFonts;
+	std::string		myCacheDir;
+};
+
+} // end of namespace ceng
+
+#endif
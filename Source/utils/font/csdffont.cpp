@@ -0,0 +1,356 @@
+#include "csdffont.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace ceng {
+
+namespace {
+
+struct SDFSegment
+{
+	SDFSegment( float x0, float y0, float x1, float y1 ) : x0( x0 ), y0( y0 ), x1( x1 ), y1( y1 ) { }
+	float x0, y0, x1, y1;
+};
+
+// quadratic bezier as line segments roughly two pixels long
+void AddCurve( std::vector< SDFSegment >& segments, float x0, float y0, float cx, float cy, float x1, float y1 )
+{
+	const float length = fabsf( cx - x0 ) + fabsf( cy - y0 ) + fabsf( x1 - cx ) + fabsf( y1 - cy );
+	const int pieces = std::min( 16, (int)( length * 0.5f ) + 1 );
+
+	float px = x0;
+	float py = y0;
+	for( int k = 1; k <= pieces; ++k )
+	{
+		const float t = (float)k / (float)pieces;
+		const float s = 1.f - t;
+		const float qx = s * s * x0 + 2.f * s * t * cx + t * t * x1;
+		const float qy = s * s * y0 + 2.f * s * t * cy + t * t * y1;
+		segments.push_back( SDFSegment( px, py, qx, qy ) );
+		px = qx;
+		py = qy;
+	}
+}
+
+float DistanceSquared( const SDFSegment& seg, float px, float py )
+{
+	const float dx = seg.x1 - seg.x0;
+	const float dy = seg.y1 - seg.y0;
+	const float length_sq = dx * dx + dy * dy;
+
+	float t = 0;
+	if( length_sq > 0 )
+		t = std::max( 0.f, std::min( 1.f, ( ( px - seg.x0 ) * dx + ( py - seg.y0 ) * dy ) / length_sq ) );
+
+	const float ex = seg.x0 + t * dx - px;
+	const float ey = seg.y0 + t * dy - py;
+	return ex * ex + ey * ey;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+
+void CSDFFont::Clear()
+{
+	myAtlas.Clear();
+	myCharQuads.clear();
+	myExtraGlyphs.clear();
+	myKerning.clear();
+	mySource = NULL;
+	myBaseSize = 0;
+	myScale = 0;
+	mySpread = 0;
+	myFirstChar = 0;
+	myNumChars = 0;
+	myPackX = 0;
+	myPackY = 0;
+	myPackBottom = 0;
+}
+
+bool CSDFFont::Bake( const CFontSource& source, float base_size, float spread, int first_char, int num_chars )
+{
+	Clear();
+
+	if( source.IsValid() == false || num_chars <= 0 || base_size <= 0 || spread <= 0 )
+		return false;
+
+	const stbtt_fontinfo* info = &source.GetInfo();
+
+	mySource = &source;
+	myBaseSize = base_size;
+	myScale = stbtt_ScaleForPixelHeight( info, base_size );
+	mySpread = spread;
+
+	int width = 0;
+	int height = 0;
+	CFontAtlas::EstimateSize( num_chars, base_size + 2 * GetPadding(), width, height );
+	myAtlas.Resize( width, height );
+
+	myCharQuads.resize( first_char + num_chars );
+
+	myPackX = 1;
+	myPackY = 1;
+	myPackBottom = 1;
+	for( int i = 0; i < num_chars; ++i )
+	{
+		if( AddGlyph( first_char + i, myCharQuads[ first_char + i ] ) == false )
+		{
+			Clear();
+			return false;
+		}
+	}
+
+	myFirstChar = first_char;
+	myNumChars = num_chars;
+
+	BuildKerning();
+
+	return true;
+}
+
+bool CSDFFont::AddGlyph( int codepoint, CharQuad& out )
+{
+	if( mySource == NULL || mySource->IsValid() == false || myAtlas.GetWidth() <= 0 )
+		return false;
+
+	const stbtt_fontinfo* info = &mySource->GetInfo();
+	const int pad = GetPadding();
+
+	int advance = 0;
+	int lsb = 0;
+	int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+	stbtt_GetCodepointHMetrics( info, codepoint, &advance, &lsb );
+	stbtt_GetCodepointBitmapBox( info, codepoint, myScale, myScale, &x0, &y0, &x1, &y1 );
+
+	int w = 0;
+	int h = 0;
+	if( x1 > x0 && y1 > y0 )
+	{
+		x0 -= pad;
+		y0 -= pad;
+		w = x1 - x0 + pad;
+		h = y1 - y0 + pad;
+	}
+
+	if( w + 2 > myAtlas.GetWidth() )
+		return false;
+
+	if( myPackX + w + 1 >= myAtlas.GetWidth() )
+	{
+		myPackX = 1;
+		myPackY = myPackBottom;
+	}
+
+	if( myPackY + h + 1 >= myAtlas.GetHeight() )
+	{
+		int new_height = myAtlas.GetHeight();
+		while( myPackY + h + 1 >= new_height )
+			new_height *= 2;
+		myAtlas.Grow( new_height );
+	}
+
+	if( w > 0 )
+		BakeGlyph( codepoint, myPackX, myPackY, w, h, x0, y0 );
+
+	out = CharQuad( 
+		types::rect( (float)myPackX, (float)myPackY, (float)w, (float)h ),
+		types::vector2( (float)x0, (float)y0 ),
+		myScale * advance );
+	out.height = myBaseSize;
+
+	myPackX += w + 1;
+	myPackBottom = std::max( myPackBottom, myPackY + h + 1 );
+
+	return true;
+}
+
+void CSDFFont::BakeGlyph( int codepoint, int atlas_x, int atlas_y, int w, int h, int x0, int y0 )
+{
+	const stbtt_fontinfo* info = &mySource->GetInfo();
+
+	// outline in base pixels, y down like the bitmap box
+	stbtt_vertex* vertices = NULL;
+	const int num_vertices = stbtt_GetGlyphShape( info, stbtt_FindGlyphIndex( info, codepoint ), &vertices );
+
+	std::vector< SDFSegment > segments;
+	float start_x = 0, start_y = 0;
+	float px = 0, py = 0;
+	for( int i = 0; i < num_vertices; ++i )
+	{
+		const stbtt_vertex& v = vertices[ i ];
+		const float x = v.x * myScale;
+		const float y = -v.y * myScale;
+
+		switch( v.type )
+		{
+		case STBTT_vmove:
+			if( px != start_x || py != start_y )
+				segments.push_back( SDFSegment( px, py, start_x, start_y ) );
+			start_x = x;
+			start_y = y;
+			break;
+
+		case STBTT_vline:
+			segments.push_back( SDFSegment( px, py, x, y ) );
+			break;
+
+		case STBTT_vcurve:
+			AddCurve( segments, px, py, v.cx * myScale, -v.cy * myScale, x, y );
+			break;
+		}
+
+		px = x;
+		py = y;
+	}
+
+	if( num_vertices > 0 && ( px != start_x || py != start_y ) )
+		segments.push_back( SDFSegment( px, py, start_x, start_y ) );
+
+	stbtt_FreeShape( info, vertices );
+
+	unsigned char* pixels = myAtlas.GetPixels();
+	const int stride = myAtlas.GetWidth();
+	const float spread_sq = mySpread * mySpread;
+
+	for( int j = 0; j < h; ++j )
+	{
+		const float sy = y0 + j + 0.5f;
+		for( int i = 0; i < w; ++i )
+		{
+			const float sx = x0 + i + 0.5f;
+
+			// nearest outline, saturating at the spread, and the non-zero
+			// winding rule for inside / outside
+			float best = spread_sq;
+			int winding = 0;
+			for( std::size_t k = 0; k < segments.size(); ++k )
+			{
+				const SDFSegment& seg = segments[ k ];
+				best = std::min( best, DistanceSquared( seg, sx, sy ) );
+
+				if( ( seg.y0 <= sy ) != ( seg.y1 <= sy ) )
+				{
+					const float cross_x = seg.x0 + ( sy - seg.y0 ) * ( seg.x1 - seg.x0 ) / ( seg.y1 - seg.y0 );
+					if( cross_x > sx )
+						winding += ( seg.y1 > seg.y0 ) ? 1 : -1;
+				}
+			}
+
+			float distance = sqrtf( best );
+			if( winding == 0 ) 
+				distance = -distance;
+
+			const float value = 128.f + distance / mySpread * 127.f;
+			pixels[ ( atlas_x + i ) + ( atlas_y + j ) * stride ] = (unsigned char)std::max( 0.f, std::min( 255.f, value + 0.5f ) );
+		}
+	}
+}
+
+const CharQuad* CSDFFont::GetGlyph( int codepoint )
+{
+	if( codepoint < 32 || codepoint == 127 )
+		return NULL;
+
+	if( HasChar( codepoint ) )
+		return &myCharQuads[ codepoint ];
+
+	std::map< int, CharQuad >::const_iterator i = myExtraGlyphs.find( codepoint );
+	if( i != myExtraGlyphs.end() )
+		return &i->second;
+
+	CharQuad quad;
+	if( AddGlyph( codepoint, quad ) == false )
+		return NULL;
+
+	return &( myExtraGlyphs[ codepoint ] = quad );
+}
+
+void CSDFFont::BuildKerning()
+{
+	myKerning.clear();
+
+	if( mySource == NULL || mySource->IsValid() == false || mySource->GetInfo().kern == 0 )
+		return;
+
+	const stbtt_fontinfo* info = &mySource->GetInfo();
+
+	// same as CFont::BuildKerning(), the cmap lookup once per glyph
+	std::vector< int > glyph_index( myNumChars );
+	for( int i = 0; i < myNumChars; ++i )
+		glyph_index[ i ] = stbtt_FindGlyphIndex( info, myFirstChar + i );
+
+	myKerning.resize( myNumChars * myNumChars, 0 );
+
+	bool any_kerning = false;
+	for( int a = 0; a < myNumChars; ++a )
+	{
+		for( int b = 0; b < myNumChars; ++b )
+		{
+			const int kern = stbtt_GetGlyphKernAdvance( info, glyph_index[ a ], glyph_index[ b ] );
+			if( kern != 0 )
+			{
+				myKerning[ a * myNumChars + b ] = myScale * kern;
+				any_kerning = true;
+			}
+		}
+	}
+
+	if( any_kerning == false )
+		myKerning.clear();
+}
+
+float CSDFFont::GetKerning( int c1, int c2 ) const
+{
+	if( HasChar( c1 ) && HasChar( c2 ) )
+	{
+		if( myKerning.empty() )
+			return 0;
+
+		return myKerning[ ( c1 - myFirstChar ) * myNumChars + ( c2 - myFirstChar ) ];
+	}
+
+	// outside the baked range, rare enough to just look it up
+	if( mySource == NULL || mySource->IsValid() == false )
+		return 0;
+
+	return myScale * stbtt_GetCodepointKernAdvance( &mySource->GetInfo(), c1, c2 );
+}
+
+unsigned char CSDFFont::SampleCoverage( const CharQuad& glyph, float u, float v, float scale ) const
+{
+	const int w = (int)glyph.rect.w;
+	const int h = (int)glyph.rect.h;
+	const int gx = (int)glyph.rect.x;
+	const int gy = (int)glyph.rect.y;
+
+	const float fu = floorf( u );
+	const float fv = floorf( v );
+	const int iu = (int)fu;
+	const int iv = (int)fv;
+	const float tu = u - fu;
+	const float tv = v - fv;
+
+	// texels outside the glyph box are as far outside as it gets
+	float texel[ 4 ];
+	for( int k = 0; k < 4; ++k )
+	{
+		const int x = iu + ( k & 1 );
+		const int y = iv + ( k >> 1 );
+		texel[ k ] = ( x < 0 || y < 0 || x >= w || y >= h ) ? 0.f : (float)myAtlas.Rand( gx + x, gy + y );
+	}
+
+	const float top = texel[ 0 ] + ( texel[ 1 ] - texel[ 0 ] ) * tu;
+	const float bottom = texel[ 2 ] + ( texel[ 3 ] - texel[ 2 ] ) * tu;
+	const float value = top + ( bottom - top ) * tv;
+
+	// distance in destination pixels, smoothstepped over one pixel
+	const float distance = ( value - 128.f ) / 127.f * mySpread * scale;
+	float t = std::max( 0.f, std::min( 1.f, distance + 0.5f ) );
+	t = t * t * ( 3.f - 2.f * t );
+
+	return (unsigned char)( t * 255.f + 0.5f );
+}
+
+} // end of namespace ceng
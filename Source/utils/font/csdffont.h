@@ -0,0 +1,100 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CSDFFont
+// ========
+//
+// Signed distance field version of CFont. The glyph outlines are turned into
+// distance fields once, at a base size, and text can then be drawn at any
+// size from that one atlas: the field is sampled bilinearly and turned into
+// coverage with a smoothstep one destination pixel wide.
+//
+// Atlas values are 128 on the outline, growing towards 255 inside the glyph
+// and falling towards 0 outside. They saturate at GetSpread() base pixels.
+//
+//.............................................................................
+#ifndef INC_CSDFFONT_H
+#define INC_CSDFFONT_H
+
+#include <math.h>
+#include <map>
+#include <vector>
+
+#include "cfont.h"
+
+namespace ceng {
+
+class CSDFFont
+{
+public:
+	CSDFFont() : 
+		myAtlas(), 
+		myCharQuads(), 
+		myExtraGlyphs(),
+		myKerning(),
+		mySource( NULL ), 
+		myBaseSize( 0 ), 
+		myScale( 0 ), 
+		mySpread( 0 ), 
+		myFirstChar( 0 ), 
+		myNumChars( 0 ),
+		myPackX( 0 ),
+		myPackY( 0 ),
+		myPackBottom( 0 )
+	{ 
+	}
+
+	//! builds distance fields for [first_char, first_char + num_chars) at
+	//! pixel height base_size. Distances saturate at spread base pixels, which
+	//! is also the padding around every glyph in the atlas
+	bool Bake( const CFontSource& source, float base_size = 64, float spread = 8, int first_char = 32, int num_chars = 95 );
+
+	void Clear();
+
+	bool HasChar( int c ) const { return c >= myFirstChar && c < myFirstChar + myNumChars; }
+
+	//! in base size pixels. rect and offset include the spread padding.
+	//! Codepoints outside the baked range get their distance field built
+	//! into the atlas the first time they are asked for, like CFont does
+	const CharQuad* GetGlyph( int codepoint );
+
+	//! in base size pixels, from a table over the baked range. Text at other
+	//! sizes scales it by size / GetBaseSize()
+	float GetKerning( int c1, int c2 ) const;
+
+	float GetBaseSize() const	{ return myBaseSize; }
+	float GetSpread() const		{ return mySpread; }
+	int GetPadding() const		{ return (int)ceil( mySpread ); }
+
+	const CFontAtlas& GetAtlas() const { return myAtlas; }
+
+	//! coverage of the glyph at atlas position (u, v) in glyph texels, for a
+	//! destination that is scale times the base size
+	unsigned char SampleCoverage( const CharQuad& glyph, float u, float v, float scale ) const;
+
+private:
+	// places the glyph in the free part of the atlas and builds its field
+	bool AddGlyph( int codepoint, CharQuad& out );
+	void BakeGlyph( int codepoint, int atlas_x, int atlas_y, int w, int h, int x0, int y0 );
+	void BuildKerning();
+
+	CFontAtlas				myAtlas;
+	std::vector< CharQuad >	myCharQuads;
+	std::map< int, CharQuad > myExtraGlyphs;
+	std::vector< float >	myKerning;			// myNumChars x myNumChars, empty if the font has no kerning
+	const CFontSource*		mySource;
+
+	float					myBaseSize;
+	float					myScale;
+	float					mySpread;
+	int						myFirstChar;
+	int						myNumChars;
+
+	// shelf packer state, kept for the glyphs added after the bake
+	int						myPackX;
+	int						myPackY;
+	int						myPackBottom;
+};
+
+} // end of namespace ceng
+
+#endif
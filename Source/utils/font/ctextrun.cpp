@@ -0,0 +1,330 @@
+#include "ctextrun.h"
+
+#include <math.h>
+#include <algorithm>
+
+namespace ceng {
+
+const CTextRun* CTextRunCache::GetRun( CFont* font, const std::string& text )
+{
+	if( font == NULL )
+		return NULL;
+
+	const Key key( font, font->GetSize(), text );
+
+	CTextRun* run = FindRun( key );
+	if( run )
+		return run;
+
+	run = AddRun( key );
+	BuildRun( font, text, *run );
+	return run;
+}
+
+const CTextRun* CTextRunCache::GetRun( CSDFFont* font, float size, const std::string& text )
+{
+	if( font == NULL )
+		return NULL;
+
+	const Key key( font, size, text );
+
+	CTextRun* run = FindRun( key );
+	if( run )
+		return run;
+
+	run = AddRun( key );
+	BuildRun( font, size, text, *run );
+	return run;
+}
+
+CTextRun* CTextRunCache::FindRun( const Key& key )
+{
+	RunMap::iterator i = myRuns.find( key );
+	if( i == myRuns.end() )
+		return NULL;
+
+	myUse.splice( myUse.begin(), myUse, i->second.use );
+	return i->second.run;
+}
+
+CTextRun* CTextRunCache::AddRun( const Key& key )
+{
+	// pinned runs can't go anywhere, the cache catches up on the next add
+	// after the pins are gone
+	if( myPinned == 0 )
+		Evict( myMaxRuns - 1 );
+
+	RunMap::iterator i = myRuns.insert( std::make_pair( key, Entry() ) ).first;
+	myUse.push_front( &i->first );
+	i->second.use = myUse.begin();
+	i->second.run = new CTextRun;
+	return i->second.run;
+}
+
+void CTextRunCache::Evict( int max_runs )
+{
+	while( (int)myRuns.size() > std::max( max_runs, 0 ) )
+	{
+		RunMap::iterator i = myRuns.find( *myUse.back() );
+		delete i->second.run;
+		myRuns.erase( i );
+		myUse.pop_back();
+	}
+}
+
+void CTextRunCache::Clear()
+{
+	for( RunMap::iterator i = myRuns.begin(); i != myRuns.end(); ++i )
+		delete i->second.run;
+	myRuns.clear();
+	myUse.clear();
+}
+
+void CTextRunCache::BuildRun( CFont* font, const std::string& text, CTextRun& out )
+{
+	out = CTextRun();
+
+	// layout. The pen keeps its fraction, each glyph is drawn at the whole
+	// pixel below it from the nearest subpixel phase
+	std::vector< const CharQuad* > glyphs;
+	std::vector< int > pens;
+
+	const int phases = CFont::subpixel_phases;
+
+	float pen_x = 0;
+	int previous = -1;
+	int left = 0, top = 0, right = 0, bottom = 0;
+	for( std::size_t i = 0; i < text.size(); )
+	{
+		const int codepoint = DecodeUTF8( text, i );
+
+		// the phase comes from the kerned pen, but the kerning only counts
+		// if the glyph turns out to exist. Only the phase it lands on gets
+		// rasterised
+		const float kerning = ( previous >= 0 ) ? font->GetKerning( previous, codepoint ) : 0;
+		const float kerned_x = pen_x + kerning;
+
+		int pen = (int)floor( kerned_x );
+		int phase = (int)( ( kerned_x - pen ) * phases + 0.5f );
+		if( phase >= phases )
+		{
+			phase = 0;
+			pen++;
+		}
+
+		const CharQuad* quad = font->GetGlyph( codepoint, phase );
+		if( quad == NULL ) continue;
+
+		out.width += kerning;
+		pen_x = kerned_x;
+		previous = codepoint;
+
+		out.width += quad->width;
+		out.height = std::max( quad->rect.h, out.height );
+		pen_x += quad->width;
+
+		const int x0 = pen + (int)quad->offset.x;
+		const int y0 = (int)quad->offset.y;
+		const int x1 = x0 + (int)quad->rect.w;
+		const int y1 = y0 + (int)quad->rect.h;
+
+		if( glyphs.empty() )
+		{
+			left = x0; top = y0; right = x1; bottom = y1;
+		}
+		else
+		{
+			left = std::min( left, x0 );
+			top = std::min( top, y0 );
+			right = std::max( right, x1 );
+			bottom = std::max( bottom, y1 );
+		}
+
+		glyphs.push_back( quad );
+		pens.push_back( pen );
+	}
+
+	if( right <= left || bottom <= top )
+		return;
+
+	out.left = left;
+	out.top = top;
+	out.coverage.ResizeUninitialized( right - left, bottom - top );
+	out.coverage.SetEverythingTo( 0 );
+
+	// the atlas is only looked at now, adding glyphs above may have grown it
+	const CFontAtlas& atlas = font->GetAtlas();
+
+	for( std::size_t g = 0; g < glyphs.size(); ++g )
+	{
+		const CharQuad& quad = *glyphs[ g ];
+		const int ox = pens[ g ] + (int)quad.offset.x - left;
+		const int oy = (int)quad.offset.y - top;
+
+		const int qw = (int)quad.rect.w;
+		for( int y = 0; y < quad.rect.h; ++y )
+		{
+			const unsigned char* src = atlas.Row( y + (int)quad.rect.y ) + (int)quad.rect.x;
+			unsigned char* dest = out.coverage.Row( oy + y ) + ox;
+			for( int x = 0; x < qw; ++x )
+			{
+				const int c = src[ x ];
+				if( c == 0 ) continue;
+
+				// where glyph boxes overlap this is the same as blending the
+				// glyphs one after the other
+				dest[ x ] = (unsigned char)( 255 - ( ( 255 - dest[ x ] ) * ( 255 - c ) + 127 ) / 255 );
+			}
+		}
+	}
+
+	BuildSpans( out );
+}
+
+void CTextRunCache::BuildRun( CSDFFont* font, float size, const std::string& text, CTextRun& out )
+{
+	out = CTextRun();
+
+	if( font->GetBaseSize() <= 0 )
+		return;
+
+	// the field is scaled, so pen positions stay fractional and every glyph
+	// gets sampled at its exact position
+	const float scale = size / font->GetBaseSize();
+	const int pad = font->GetPadding();
+
+	std::vector< const CharQuad* > glyphs;
+	std::vector< float > pens;
+
+	float pen = 0;
+	int previous = -1;
+	int left = 0, top = 0, right = 0, bottom = 0;
+	for( std::size_t i = 0; i < text.size(); )
+	{
+		const int codepoint = DecodeUTF8( text, i );
+		const CharQuad* quad = font->GetGlyph( codepoint );
+		if( quad == NULL ) continue;
+
+		if( previous >= 0 )
+		{
+			const float kerning = font->GetKerning( previous, codepoint ) * scale;
+			out.width += kerning;
+			pen += kerning;
+		}
+		previous = codepoint;
+
+		out.width += quad->width * scale;
+		pen += quad->width * scale;
+		if( quad->rect.w <= 0 || quad->rect.h <= 0 ) continue;
+
+		// the height excludes the padding, same as the bitmap fonts
+		out.height = std::max( ( quad->rect.h - 2 * pad ) * scale, out.height );
+
+		const float glyph_pen = pen - quad->width * scale;
+		const int x0 = (int)floor( glyph_pen + quad->offset.x * scale );
+		const int y0 = (int)floor( quad->offset.y * scale );
+		const int x1 = (int)ceil( glyph_pen + ( quad->offset.x + quad->rect.w ) * scale );
+		const int y1 = (int)ceil( ( quad->offset.y + quad->rect.h ) * scale );
+
+		if( glyphs.empty() )
+		{
+			left = x0; top = y0; right = x1; bottom = y1;
+		}
+		else
+		{
+			left = std::min( left, x0 );
+			top = std::min( top, y0 );
+			right = std::max( right, x1 );
+			bottom = std::max( bottom, y1 );
+		}
+
+		glyphs.push_back( quad );
+		pens.push_back( glyph_pen );
+	}
+
+	if( right <= left || bottom <= top )
+		return;
+
+	out.left = left;
+	out.top = top;
+	out.coverage.ResizeUninitialized( right - left, bottom - top );
+	out.coverage.SetEverythingTo( 0 );
+
+	for( std::size_t g = 0; g < glyphs.size(); ++g )
+	{
+		const CharQuad& quad = *glyphs[ g ];
+		const float gx = pens[ g ] + quad.offset.x * scale;
+		const float gy = quad.offset.y * scale;
+
+		const int x0 = (int)floor( gx );
+		const int y0 = (int)floor( gy );
+		const int x1 = (int)ceil( gx + quad.rect.w * scale );
+		const int y1 = (int)ceil( gy + quad.rect.h * scale );
+
+		for( int y = y0; y < y1; ++y )
+		{
+			const float v = ( y + 0.5f - gy ) / scale - 0.5f;
+			for( int x = x0; x < x1; ++x )
+			{
+				const float u = ( x + 0.5f - gx ) / scale - 0.5f;
+				const int c = font->SampleCoverage( quad, u, v, scale );
+				if( c == 0 ) continue;
+
+				unsigned char& dest = out.coverage.Rand( x - left, y - top );
+				dest = (unsigned char)( 255 - ( ( 255 - dest ) * ( 255 - c ) + 127 ) / 255 );
+			}
+		}
+	}
+
+	BuildSpans( out );
+}
+
+void CTextRunCache::BuildSpans( CTextRun& run )
+{
+	run.spans.clear();
+
+	// shorter fully covered stretches stay in the blended span around them,
+	// a separate span costs more than blending a few pixels
+	const int min_opaque = 4;
+
+	const int w = run.coverage.GetWidth();
+	for( int y = 0; y < run.coverage.GetHeight(); ++y )
+	{
+		const unsigned char* row = run.coverage.Row( y );
+
+		int x = 0;
+		while( x < w )
+		{
+			while( x < w && row[ x ] == 0 ) ++x;
+			if( x >= w ) break;
+
+			// [ start, x ) is non-zero, split into blended and opaque parts
+			int start = x;
+			while( x < w && row[ x ] != 0 )
+			{
+				if( row[ x ] != 255 ) 
+				{
+					++x;
+					continue;
+				}
+
+				int end = x;
+				while( end < w && row[ end ] == 255 ) ++end;
+
+				if( end - x >= min_opaque )
+				{
+					if( x > start )
+						run.spans.push_back( CCoverageSpan( start, y, x - start, false ) );
+					run.spans.push_back( CCoverageSpan( x, y, end - x, true ) );
+					start = end;
+				}
+				x = end;
+			}
+
+			if( x > start )
+				run.spans.push_back( CCoverageSpan( start, y, x - start, false ) );
+		}
+	}
+}
+
+} // end of namespace ceng
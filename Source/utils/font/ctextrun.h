@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CTextRun
+// ========
+//
+// A laid out string: its extent and the coverage of all of its glyphs
+// composited into one bitmap, so drawing a label again is a single coverage
+// blit instead of laying out and blending glyph by glyph. The coverage is
+// also kept as spans of non-zero pixels, so drawing never looks at the empty
+// parts of the bitmap and fully covered stretches are just stored.
+//
+// CTextRunCache keeps runs by (font, size, string). Fonts are identified by
+// their address, so clear the cache if fonts are destroyed. Runs from a
+// CSDFFont are keyed by the size they are drawn at.
+//
+//.............................................................................
+#ifndef INC_CTEXTRUN_H
+#define INC_CTEXTRUN_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cfont.h"
+#include "csdffont.h"
+
+namespace ceng {
+
+//! horizontal stretch of non-zero coverage in CTextRun::coverage
+struct CCoverageSpan
+{
+	CCoverageSpan() : x( 0 ), y( 0 ), length( 0 ), opaque( false ) { }
+	CCoverageSpan( int x, int y, int length, bool opaque ) : x( x ), y( y ), length( length ), opaque( opaque ) { }
+
+	int x;
+	int y;
+	int length;
+
+	//! every pixel is 255, nothing to blend
+	bool opaque;
+};
+
+//-----------------------------------------------------------------------------
+
+struct CTextRun
+{
+	CTextRun() : width( 0 ), height( 0 ), left( 0 ), top( 0 ), coverage(), spans() { }
+
+	//! sum of the advances and the tallest glyph, what the text is centered by
+	float width;
+	float height;
+
+	//! where coverage starts relative to the pen position of the first glyph
+	int left;
+	int top;
+
+	CArray2D< unsigned char > coverage;
+
+	//! row by row, left to right
+	std::vector< CCoverageSpan > spans;
+};
+
+//-----------------------------------------------------------------------------
+
+class CTextRunCache
+{
+public:
+	CTextRunCache() : myRuns(), myUse(), myMaxRuns( 4096 ), myPinned( 0 ) { }
+	~CTextRunCache() { Clear(); }
+
+	//! lays out and composites text the first time, NULL if font is NULL
+	const CTextRun* GetRun( CFont* font, const std::string& text );
+
+	//! same for a distance field font drawn at pixel height size
+	const CTextRun* GetRun( CSDFFont* font, float size, const std::string& text );
+
+	//! the least recently used runs are dropped to keep the cache at this
+	//! size
+	void SetMaxRuns( int max_runs ) { myMaxRuns = max_runs; }
+
+	//! while pinned the runs handed out stay alive even if the cache goes
+	//! over its size, for draw lists that hold on to them. Pins nest
+	void Pin() { ++myPinned; }
+	void Unpin() { if( myPinned > 0 ) --myPinned; }
+
+	int GetSize() const { return (int)myRuns.size(); }
+
+	void Clear();
+
+	static void BuildRun( CFont* font, const std::string& text, CTextRun& out );
+	static void BuildRun( CSDFFont* font, float size, const std::string& text, CTextRun& out );
+
+	//! fills run.spans from run.coverage
+	static void BuildSpans( CTextRun& run );
+
+private:
+	// not copyable, owns the runs
+	CTextRunCache( const CTextRunCache& );
+	const CTextRunCache& operator=( const CTextRunCache& );
+
+	struct Key
+	{
+		Key( const void* font, float size, const std::string& text ) : font( font ), size( size ), text( text ) { }
+
+		bool operator<( const Key& other ) const
+		{
+			if( font != other.font ) return font < other.font;
+			if( size != other.size ) return size < other.size;
+			return text < other.text;
+		}
+
+		const void*		font;
+		float			size;
+		std::string		text;
+	};
+
+	typedef std::list< const Key* > UseList;
+
+	struct Entry
+	{
+		CTextRun*			run;
+		UseList::iterator	use;		// where the key is in myUse
+	};
+
+	typedef std::map< Key, Entry > RunMap;
+
+	// the run for key, moved to the front of myUse. NULL if there's none
+	CTextRun* FindRun( const Key& key );
+	CTextRun* AddRun( const Key& key );
+
+	// drops the least recently used runs until there are at most max_runs
+	void Evict( int max_runs );
+
+	RunMap	myRuns;
+	UseList	myUse;		// most recently used first, points to the keys in myRuns
+	int		myMaxRuns;
+	int		myPinned;
+};
+
+} // end of namespace ceng
+
+#endif
@@ -0,0 +1,34 @@
+#include "cpngencoder.h"
+
+#include <stdlib.h>
+
+#include "../memory/carena.h"
+
+#define STBIW_MALLOC( size )		ceng::ArenaMalloc( size )
+#define STBIW_REALLOC( p, size )	ceng::ArenaRealloc( p, size )
+#define STBIW_FREE( p )				ceng::ArenaFree( p )
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../../stb/stb_image_write.h"
+
+namespace ceng {
+
+unsigned char* EncodePNG( const unsigned char* pixels, int stride, int w, int h, int& out_size, CArena* arena )
+{
+	CArena* previous = GetMallocArena();
+	SetMallocArena( arena );
+
+	out_size = 0;
+	unsigned char* png = stbi_write_png_to_mem( (unsigned char*)pixels, stride, w, h, 4, &out_size );
+
+	SetMallocArena( previous );
+	return png;
+}
+
+void FreePNG( unsigned char* png, CArena* arena )
+{
+	if( arena == NULL || arena->Owns( png ) == false )
+		free( png );
+}
+
+} // end of namespace ceng
@@ -0,0 +1,34 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// PNG encoding
+// ============
+//
+// stb_image_write's png encoder, with everything it allocates coming from a
+// CArena when there is one. This is the one place the stb_image_write
+// implementation gets compiled, its STBIW_MALLOC() & co go to ArenaMalloc()
+// & co.
+//
+// The arena reaches the encoder through SetMallocArena(), which is process
+// wide. EncodePNG() must not run on two threads at once, or on one thread
+// while another one uses the arena malloc hooks. It puts back whatever arena
+// was set before it, so calling it with one already set is fine.
+//
+//.............................................................................
+#ifndef INC_CPNGENCODER_H
+#define INC_CPNGENCODER_H
+
+namespace ceng {
+
+class CArena;
+
+//! pixels are w x h RGBA8, stride bytes from one row to the next. Returns
+//! the png, its size goes to out_size. NULL if it couldn't be encoded
+unsigned char* EncodePNG( const unsigned char* pixels, int stride, int w, int h, int& out_size, CArena* arena = NULL );
+
+//! png from EncodePNG() with the same arena. The arena's memory is left for
+//! its Reset()
+void FreePNG( unsigned char* png, CArena* arena = NULL );
+
+} // end of namespace ceng
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef INC_CRECT_H
+#define INC_CRECT_H
+
+namespace types
+{
+	struct rect
+	{
+		rect() : x(0),y(0),w(0),h(0) { }
+		rect( float x, float y, float w, float h ) : x(x), y(y), w(w), h(h) { }
+		float x, y, w, h;
+	};
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include "carena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace ceng {
+
+CArena::CArena( size_t block_size ) :
+	myBlocks(),
+	myOffset( 0 ),
+	myNextBlockSize( block_size > 0 ? block_size : 1 ),
+	myUsed( 0 ),
+	myHeapAllocations( 0 )
+{
+}
+
+CArena::~CArena()
+{
+	Clear();
+}
+
+void* CArena::Allocate( size_t bytes, size_t align )
+{
+	if( align == 0 )
+		align = 1;
+
+	if( myBlocks.empty() == false )
+	{
+		const Block& block = myBlocks.back();
+		const size_t address = (size_t)( block.data + myOffset );
+		const size_t padding = ( align - ( address & ( align - 1 ) ) ) & ( align - 1 );
+		if( padding + bytes <= block.size - myOffset )
+		{
+			unsigned char* result = block.data + myOffset + padding;
+			myOffset += padding + bytes;
+			myUsed += padding + bytes;
+			return result;
+		}
+	}
+
+	// a block is aligned for anything new gives out, the extra is for
+	// bigger alignments than that
+	AddBlock( bytes + align );
+	return Allocate( bytes, align );
+}
+
+void CArena::AddBlock( size_t min_size )
+{
+	// blocks double from the first one's size. Something bigger than that
+	// gets a block of its own size, so that one big allocation doesn't
+	// double every block after it
+	size_t size = myNextBlockSize;
+	if( size < min_size )
+		size = min_size;
+	myNextBlockSize *= 2;
+
+	Block block;
+	block.data = new unsigned char[ size ];
+	block.size = size;
+	myBlocks.push_back( block );
+	myOffset = 0;
+	myHeapAllocations++;
+}
+
+bool CArena::Extend( void* p, size_t old_bytes, size_t new_bytes )
+{
+	if( myBlocks.empty() )
+		return false;
+
+	const Block& block = myBlocks.back();
+	unsigned char* start = (unsigned char*)p;
+	if( start + old_bytes != block.data + myOffset || new_bytes < old_bytes || new_bytes - old_bytes > block.size - myOffset )
+		return false;
+
+	myOffset += new_bytes - old_bytes;
+	myUsed += new_bytes - old_bytes;
+	return true;
+}
+
+bool CArena::Owns( const void* p ) const
+{
+	const unsigned char* address = (const unsigned char*)p;
+	for( std::size_t i = 0; i < myBlocks.size(); ++i )
+	{
+		if( address >= myBlocks[ i ].data && address < myBlocks[ i ].data + myBlocks[ i ].size )
+			return true;
+	}
+
+	return false;
+}
+
+void CArena::Reset()
+{
+	// one block as big as all of them, the next round fits in it
+	if( myBlocks.size() > 1 )
+	{
+		const size_t total = GetCapacity();
+		Clear();
+		myNextBlockSize = total;
+		AddBlock( total );
+	}
+
+	myOffset = 0;
+	myUsed = 0;
+}
+
+void CArena::Clear()
+{
+	for( std::size_t i = 0; i < myBlocks.size(); ++i )
+		delete [] myBlocks[ i ].data;
+
+	myBlocks.clear();
+	myOffset = 0;
+	myUsed = 0;
+}
+
+size_t CArena::GetCapacity() const
+{
+	size_t result = 0;
+	for( std::size_t i = 0; i < myBlocks.size(); ++i )
+		result += myBlocks[ i ].size;
+
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+CArena* malloc_arena = NULL;
+
+// arena allocations keep their size in front of them for realloc, the
+// header is as big as the alignment malloc gives
+const size_t malloc_header = 16;
+
+} // end of anonymous namespace
+
+void SetMallocArena( CArena* arena )
+{
+	malloc_arena = arena;
+}
+
+CArena* GetMallocArena()
+{
+	return malloc_arena;
+}
+
+void* ArenaMalloc( size_t size )
+{
+	if( malloc_arena == NULL )
+		return malloc( size );
+
+	unsigned char* result = (unsigned char*)malloc_arena->Allocate( malloc_header + size, malloc_header );
+	*(size_t*)result = size;
+	return result + malloc_header;
+}
+
+void* ArenaRealloc( void* p, size_t size )
+{
+	if( p == NULL )
+		return ArenaMalloc( size );
+
+	if( malloc_arena == NULL || malloc_arena->Owns( p ) == false )
+		return realloc( p, size );
+
+	size_t& old_size = *(size_t*)( (unsigned char*)p - malloc_header );
+	if( malloc_arena->Extend( p, old_size, size ) )
+	{
+		old_size = size;
+		return p;
+	}
+
+	// the old one stays behind until the arena is reset
+	void* result = ArenaMalloc( size );
+	memcpy( result, p, old_size < size ? old_size : size );
+	return result;
+}
+
+void ArenaFree( void* p )
+{
+	if( malloc_arena == NULL || malloc_arena->Owns( p ) == false )
+		free( p );
+}
+
+} // end of namespace ceng
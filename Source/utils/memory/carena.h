@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CArena
+// ======
+//
+// Bump allocator for temporaries that all die at the same time, like
+// everything that is only needed while one page gets rendered and saved.
+// Allocating is moving an offset forward, nothing is freed one by one,
+// Reset() drops everything at once and keeps the memory.
+//
+// When a block runs out another one is taken from the heap. Reset() merges
+// them into one block as big as all of them together, so after the first
+// page or two a job that does the same thing every page doesn't touch the
+// heap at all.
+//
+// Nothing allocated from an arena may be used after Reset() or Clear(),
+// destructors aren't run, that is up to whoever constructed something in
+// the memory (CSafeArray does it for its elements).
+//
+//.............................................................................
+#ifndef INC_CARENA_H
+#define INC_CARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace ceng {
+
+class CArena
+{
+public:
+	//! block_size is the size of the first block, taken on the first
+	//! allocation
+	explicit CArena( size_t block_size = 64 * 1024 );
+	~CArena();
+
+	//! bytes aligned to align, which has to be a power of two. Never NULL,
+	//! throws std::bad_alloc like new if the heap runs out
+	void* Allocate( size_t bytes, size_t align = 16 );
+
+	//! makes the block at p, the last one allocated, new_bytes long if
+	//! there's room right after it. False and nothing changed otherwise
+	bool Extend( void* p, size_t old_bytes, size_t new_bytes );
+
+	//! p points into memory this arena handed out
+	bool Owns( const void* p ) const;
+
+	//! forgets everything allocated, the memory is kept for the next round
+	void Reset();
+
+	//! gives all the memory back to the heap
+	void Clear();
+
+	//! bytes handed out since the last Reset(), alignment padding included
+	size_t GetUsed() const { return myUsed; }
+
+	//! bytes taken from the heap
+	size_t GetCapacity() const;
+
+	//! how many times the heap has been asked for a block, to check that
+	//! it stays put once things run in a loop
+	int GetHeapAllocations() const { return myHeapAllocations; }
+
+private:
+	// not copyable, the blocks have one owner
+	CArena( const CArena& );
+	const CArena& operator=( const CArena& );
+
+	struct Block
+	{
+		unsigned char*	data;
+		size_t			size;
+	};
+
+	void AddBlock( size_t min_size );
+
+	std::vector< Block >	myBlocks;
+	size_t					myOffset;		// into the last block
+	size_t					myNextBlockSize;	// unless more is asked for at once
+	size_t					myUsed;
+	int						myHeapAllocations;
+};
+
+//-----------------------------------------------------------------------------
+
+//! While an arena is set, ArenaMalloc() and ArenaRealloc() take their
+//! memory from it and ArenaFree() leaves the memory where it is. Without
+//! one they are malloc, realloc and free. Memory from the arena has to be
+//! given back while the arena is still set, or just left for Reset().
+//! For C code that can only be pointed at other allocation functions with
+//! macros, like stb_image_write
+void SetMallocArena( CArena* arena );
+CArena* GetMallocArena();
+
+void* ArenaMalloc( size_t size );
+void* ArenaRealloc( void* p, size_t size );
+void ArenaFree( void* p );
+
+} // end of namespace ceng
+
+#endif
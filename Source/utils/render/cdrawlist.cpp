@@ -0,0 +1,183 @@
+#include "cdrawlist.h"
+#include "../color/cblend.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace ceng {
+
+void CDrawList::FillRect( int x, int y, int w, int h, uint32 color )
+{
+	if( w <= 0 || h <= 0 )
+		return;
+
+	Command command;
+	command.type = COMMAND_FILL;
+	command.x = x;
+	command.y = y;
+	command.w = w;
+	command.h = h;
+	command.color = color;
+	myCommands.push_back( command );
+}
+
+void CDrawList::StrokeRect( int x, int y, int w, int h, int thickness, uint32 color )
+{
+	const int top = std::min( thickness, h );
+	const int bottom = std::max( top, h - thickness );
+	const int left = std::min( thickness, w );
+	const int right = std::max( left, w - thickness );
+
+	FillRect( x, y, w, top, color );
+	FillRect( x, y + bottom, w, h - bottom, color );
+	FillRect( x, y + top, left, bottom - top, color );
+	FillRect( x + right, y + top, w - right, bottom - top, color );
+}
+
+void CDrawList::BlitImage( const CArray2DView< const uint32 >& image, int x, int y )
+{
+	if( image.Empty() )
+		return;
+
+	Command command;
+	command.type = COMMAND_IMAGE;
+	command.x = x;
+	command.y = y;
+	command.w = image.GetWidth();
+	command.h = image.GetHeight();
+	command.image = image;
+	myCommands.push_back( command );
+}
+
+void CDrawList::BlitText( const CTextRun* run, int x, int y, uint32 color )
+{
+	if( run == NULL || run->spans.empty() )
+		return;
+
+	Command command;
+	command.type = COMMAND_TEXT;
+	command.x = x;
+	command.y = y;
+	command.w = run->coverage.GetWidth();
+	command.h = run->coverage.GetHeight();
+	command.color = color;
+	command.run = run;
+	myCommands.push_back( command );
+}
+
+void CDrawList::Render( const CArray2DView< uint32 >& target, CArena* arena ) const
+{
+	const int height = target.GetHeight();
+	if( height <= 0 || target.GetWidth() <= 0 || myCommands.empty() )
+		return;
+
+	// bin the commands by band, in recording order. Counted first, so all
+	// the bins fit in one flat array and [ tile_start[ t ], tile_end[ t ] )
+	// is band t's part of it
+	const int num_tiles = ( height + myTileHeight - 1 ) / myTileHeight;
+	CSafeArray< int > tile_start;
+	CSafeArray< int > tile_end;
+	CSafeArray< int > binned;
+	tile_start.SetArena( arena );
+	tile_end.SetArena( arena );
+	binned.SetArena( arena );
+
+	tile_start.Resize( num_tiles + 1 );
+	for( int pass = 0; pass < 2; ++pass )
+	{
+		for( std::size_t i = 0; i < myCommands.size(); ++i )
+		{
+			const Command& command = myCommands[ i ];
+			const int y0 = std::max( 0, command.y );
+			const int y1 = std::min( height, command.y + command.h );
+			if( y1 <= y0 ) 
+				continue;
+
+			for( int t = y0 / myTileHeight; t <= ( y1 - 1 ) / myTileHeight; ++t )
+			{
+				if( pass == 0 )
+					tile_start[ t + 1 ]++;
+				else
+					binned[ tile_end[ t ]++ ] = (int)i;
+			}
+		}
+
+		if( pass == 0 )
+		{
+			for( int t = 0; t < num_tiles; ++t )
+				tile_start[ t + 1 ] += tile_start[ t ];
+
+			binned.ResizeUninitialized( tile_start[ num_tiles ] );
+			tile_end.ResizeUninitialized( num_tiles );
+			memcpy( tile_end.data, tile_start.data, num_tiles * sizeof( int ) );
+		}
+	}
+
+	for( int t = 0; t < num_tiles; ++t )
+	{
+		const int y0 = t * myTileHeight;
+		const int y1 = std::min( height, y0 + myTileHeight );
+
+		for( int i = tile_start[ t ]; i < tile_end[ t ]; ++i )
+			Draw( myCommands[ binned[ i ] ], target, y0, y1 );
+	}
+}
+
+void CDrawList::Draw( const Command& command, const CArray2DView< uint32 >& target, int y0, int y1 ) const
+{
+	const int x0 = std::max( 0, command.x );
+	const int x1 = std::min( target.GetWidth(), command.x + command.w );
+	y0 = std::max( y0, command.y );
+	y1 = std::min( y1, command.y + command.h );
+	if( x1 <= x0 || y1 <= y0 )
+		return;
+
+	switch( command.type )
+	{
+	case COMMAND_FILL:
+		for( int y = y0; y < y1; ++y )
+		{
+			uint32* row = target.Row( y );
+			std::fill( row + x0, row + x1, command.color );
+		}
+		break;
+
+	case COMMAND_IMAGE:
+		for( int y = y0; y < y1; ++y )
+		{
+			memcpy( target.Row( y ) + x0, command.image.Row( y - command.y ) + x0 - command.x, ( x1 - x0 ) * sizeof( uint32 ) );
+		}
+		break;
+
+	case COMMAND_TEXT:
+		{
+			// spans are sorted by row, skip to the first one in the band
+			const std::vector< CCoverageSpan >& spans = command.run->spans;
+			std::size_t i = 0;
+			while( i < spans.size() && spans[ i ].y + command.y < y0 ) 
+				++i;
+
+			for( ; i < spans.size(); ++i )
+			{
+				const CCoverageSpan& span = spans[ i ];
+				const int y = command.y + span.y;
+				if( y >= y1 ) 
+					break;
+
+				const int sx0 = std::max( x0, command.x + span.x );
+				const int sx1 = std::min( x1, command.x + span.x + span.length );
+				if( sx1 <= sx0 ) 
+					continue;
+
+				uint32* row = target.Row( y ) + sx0;
+				if( span.opaque )
+					FillCoverageSpan( row, sx1 - sx0, command.color );
+				else
+					BlendCoverageSpan( row, command.run->coverage.Row( span.y ) + sx0 - command.x, sx1 - sx0, command.color );
+			}
+		}
+		break;
+	}
+}
+
+} // end of namespace ceng
@@ -0,0 +1,92 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// CDrawList
+// =========
+//
+// Retained mode drawing for a page. Fills, image blits and text runs are
+// recorded instead of drawn, and Render() then goes through the page one
+// band of rows at a time, drawing whatever touches that band. The part of
+// the page being written stays small enough to live in the cache, instead
+// of every cell and label walking the whole image.
+//
+// Commands are drawn in the order they were recorded, so overlapping ones
+// come out as they would have when drawn right away. A list can be rendered
+// as many times as needed, the images and text runs it points to have to
+// stay alive for that long.
+//
+//.............................................................................
+#ifndef INC_CDRAWLIST_H
+#define INC_CDRAWLIST_H
+
+#include <vector>
+
+#include "../array2d/carray2dview.h"
+#include "../color/cpixelformat.h"
+#include "../font/ctextrun.h"
+#include "../memory/carena.h"
+
+namespace ceng {
+
+class CDrawList
+{
+public:
+	CDrawList() : myCommands(), myTileHeight( 32 ) { }
+
+	//! rows per band. 32 rows of an A4 poster at 300 dpi is about 400k
+	void SetTileHeight( int rows ) { myTileHeight = rows > 0 ? rows : 1; }
+	int GetTileHeight() const { return myTileHeight; }
+
+	void FillRect( int x, int y, int w, int h, uint32 color );
+
+	//! outline thickness pixels wide, inside the rectangle
+	void StrokeRect( int x, int y, int w, int h, int thickness, uint32 color );
+
+	//! copies image with its top left corner at ( x, y ). Only the view is
+	//! kept, the pixels it points to have to stay around
+	void BlitImage( const CArray2DView< const uint32 >& image, int x, int y );
+
+	//! blends run in color with its coverage bitmap's top left corner at
+	//! ( x, y )
+	void BlitText( const CTextRun* run, int x, int y, uint32 color );
+
+	void Clear() { myCommands.clear(); }
+
+	int GetSize() const { return (int)myCommands.size(); }
+
+	//! target can be the whole page or any part of it, coordinates are
+	//! relative to its top left corner. The bins for the bands come from
+	//! arena if there is one
+	void Render( const CArray2DView< uint32 >& target, CArena* arena = NULL ) const;
+
+private:
+	enum CommandType
+	{
+		COMMAND_FILL,
+		COMMAND_IMAGE,
+		COMMAND_TEXT
+	};
+
+	struct Command
+	{
+		Command() : type( COMMAND_FILL ), x( 0 ), y( 0 ), w( 0 ), h( 0 ), color( 0 ), image(), run( NULL ) { }
+
+		CommandType					type;
+		int							x;
+		int							y;
+		int							w;
+		int							h;
+		uint32						color;
+		CArray2DView< const uint32 >	image;
+		const CTextRun*				run;
+	};
+
+	// draws the part of command that is inside rows [ y0, y1 ) of target
+	void Draw( const Command& command, const CArray2DView< uint32 >& target, int y0, int y1 ) const;
+
+	std::vector< Command >	myCommands;
+	int						myTileHeight;
+};
+
+} // end of namespace ceng
+
+#endif
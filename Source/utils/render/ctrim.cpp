@@ -0,0 +1,119 @@
+#include "ctrim.h"
+
+#if defined( _M_X64 ) || defined( __x86_64__ ) || defined( __SSE2__ ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	define CENG_TRIM_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace ceng {
+
+namespace {
+
+// index of the first pixel in row[ 0, count ) with a bit of mask set,
+// count if there's none
+int FindFirstMasked( const uint32* row, int count, uint32 mask )
+{
+	int i = 0;
+
+#ifdef CENG_TRIM_SSE2
+	const __m128i m = _mm_set1_epi32( (int)mask );
+	const __m128i zero = _mm_setzero_si128();
+	for( ; i + 4 <= count; i += 4 )
+	{
+		const __m128i p = _mm_and_si128( _mm_loadu_si128( (const __m128i*)( row + i ) ), m );
+		if( _mm_movemask_epi8( _mm_cmpeq_epi32( p, zero ) ) != 0xFFFF )
+			break;
+	}
+#endif
+
+	// the rest, or the four pixels the hit is in
+	for( ; i < count; ++i )
+	{
+		if( row[ i ] & mask )
+			return i;
+	}
+
+	return count;
+}
+
+// one past the last pixel in row[ 0, count ) with a bit of mask set, 0 if
+// there's none
+int FindLastMasked( const uint32* row, int count, uint32 mask )
+{
+	int i = count;
+
+#ifdef CENG_TRIM_SSE2
+	const __m128i m = _mm_set1_epi32( (int)mask );
+	const __m128i zero = _mm_setzero_si128();
+	for( ; i >= 4; i -= 4 )
+	{
+		const __m128i p = _mm_and_si128( _mm_loadu_si128( (const __m128i*)( row + i - 4 ) ), m );
+		if( _mm_movemask_epi8( _mm_cmpeq_epi32( p, zero ) ) != 0xFFFF )
+			break;
+	}
+#endif
+
+	for( ; i > 0; --i )
+	{
+		if( row[ i - 1 ] & mask )
+			return i;
+	}
+
+	return 0;
+}
+
+} // end of anonymous namespace
+
+//-----------------------------------------------------------------------------
+
+bool FindImageBounds( const CArray2DView< const uint32 >& image, uint32 mask, int& out_x, int& out_y, int& out_w, int& out_h )
+{
+	out_x = 0;
+	out_y = 0;
+	out_w = 0;
+	out_h = 0;
+
+	const int w = image.GetWidth();
+	const int h = image.GetHeight();
+	if( image.Empty() )
+		return false;
+
+	int top = 0;
+	while( top < h && FindFirstMasked( image.Row( top ), w, mask ) == w )
+		++top;
+
+	if( top == h )
+		return false;
+
+	int bottom = h;
+	while( FindLastMasked( image.Row( bottom - 1 ), w, mask ) == 0 )
+		--bottom;
+
+	// [ left, right ) only ever widens, so each row is only scanned up to
+	// the current left edge and from the current right edge
+	int left = w;
+	int right = 0;
+	for( int y = top; y < bottom; ++y )
+	{
+		const uint32* row = image.Row( y );
+		left = FindFirstMasked( row, left, mask );
+		right += FindLastMasked( row + right, w - right, mask );
+	}
+
+	out_x = left;
+	out_y = top;
+	out_w = right - left;
+	out_h = bottom - top;
+	return true;
+}
+
+CArray2DView< const uint32 > TrimTransparent( const CArray2DView< const uint32 >& image )
+{
+	int x, y, w, h;
+	if( FindImageBounds( image, PixelNative::a_mask, x, y, w, h ) == false )
+		return CArray2DView< const uint32 >();
+
+	return image.SubView( x, y, w, h );
+}
+
+} // end of namespace ceng
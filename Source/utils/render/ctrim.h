@@ -0,0 +1,34 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// Trimming
+// ========
+//
+// Finds the part of an image that has something in it, the way a token
+// with a transparent margin around it gets cut down to the token itself.
+// The result is a view into the same pixels, nothing gets copied.
+//
+// Empty rows at the top and the bottom are found first, then each row in
+// between only needs to be looked at outside the columns already known to
+// have content. The rows are tested four pixels at a time with SSE2 where
+// it's available.
+//
+//.............................................................................
+#ifndef INC_CTRIM_H
+#define INC_CTRIM_H
+
+#include "../array2d/carray2dview.h"
+#include "../color/cpixelformat.h"
+
+namespace ceng {
+
+//! the smallest rectangle holding every pixel that has one of mask's bits
+//! set. Returns false and a 0 x 0 rectangle if there isn't one
+bool FindImageBounds( const CArray2DView< const uint32 >& image, uint32 mask, int& out_x, int& out_y, int& out_w, int& out_h );
+
+//! image without the fully transparent rows and columns around it. An
+//! image with nothing but transparent pixels comes back empty
+CArray2DView< const uint32 > TrimTransparent( const CArray2DView< const uint32 >& image );
+
+} // end of namespace ceng
+
+#endif
@@ -8,34 +8,170 @@
 #define cassert assert
 #endif
 
+#include <string.h>
+#include <stddef.h>
+#include <new>
+
+#include "../memory/carena.h"
+
+#if __cplusplus >= 201103L || ( defined( _MSC_VER ) && _MSC_VER >= 1600 )
+#	define CENG_HAS_MOVE 1
+#	include <utility>
+#else
+#	define CENG_HAS_MOVE 0
+#endif
+
+#if __cplusplus >= 201103L || ( defined( _MSC_VER ) && _MSC_VER >= 1900 )
+#	include <type_traits>
+#	define CENG_IS_TRIVIALLY_COPYABLE( T ) std::is_trivially_copyable< T >::value
+#else
+#	define CENG_IS_TRIVIALLY_COPYABLE( T ) ceng::CIsTriviallyCopyable< T >::value
+#endif
 
 
 namespace ceng 
 {
 
-template< typename Type, typename SizeType = int >
+//! true for types that can be copied with memcpy. Only needed by compilers
+//! that don't have std::is_trivially_copyable, so it only knows the
+//! built in types
+template< typename Type > struct CIsTriviallyCopyable { enum { value = false }; };
+template< typename Type > struct CIsTriviallyCopyable< Type* > { enum { value = true }; };
+template<> struct CIsTriviallyCopyable< bool >				{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< char >				{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< signed char >		{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< unsigned char >		{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< short >				{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< unsigned short >	{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< int >				{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< unsigned int >		{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< long >				{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< unsigned long >		{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< float >				{ enum { value = true }; };
+template<> struct CIsTriviallyCopyable< double >			{ enum { value = true }; };
+
+template< typename Type, bool Trivial = CENG_IS_TRIVIALLY_COPYABLE( Type ) >
+struct CArrayCopier
+{
+	template< typename SizeType >
+	static inline void Copy( Type* dest, const Type* src, SizeType count )
+	{
+		for( SizeType i = 0; i < count; ++i ) 
+			dest[ i ] = src[ i ];
+	}
+};
+
+template< typename Type >
+struct CArrayCopier< Type, true >
+{
+	template< typename SizeType >
+	static inline void Copy( Type* dest, const Type* src, SizeType count )
+	{
+		if( count > 0 )
+			memcpy( dest, src, count * sizeof( Type ) );
+	}
+};
+
+template< typename Type, bool Trivial = CENG_IS_TRIVIALLY_COPYABLE( Type ) >
+struct CArrayFiller
+{
+	template< typename SizeType >
+	static inline void Fill( Type* dest, SizeType count, const Type& value )
+	{
+		for( SizeType i = 0; i < count; ++i ) 
+			dest[ i ] = value;
+	}
+};
+
+template< typename Type >
+struct CArrayFiller< Type, true >
+{
+	template< typename SizeType >
+	static inline void Fill( Type* dest, SizeType count, const Type& value )
+	{
+		if( count <= 0 )
+			return;
+
+		// all bytes the same (0, 0xFFFFFFFF...) is a memset
+		const unsigned char* bytes = (const unsigned char*)&value;
+		bool same_bytes = true;
+		for( size_t i = 1; i < sizeof( Type ); ++i )
+			same_bytes = same_bytes && bytes[ i ] == bytes[ 0 ];
+
+		if( same_bytes )
+		{
+			memset( dest, bytes[ 0 ], count * sizeof( Type ) );
+			return;
+		}
+
+		// otherwise the pattern is doubled up to a block that stays in the
+		// cache and the block is copied over the rest
+		const SizeType block = ( 4096 / sizeof( Type ) ) > 0 ? (SizeType)( 4096 / sizeof( Type ) ) : 1;
+		dest[ 0 ] = value;
+		SizeType filled = 1;
+		while( filled < count )
+		{
+			SizeType n = filled < block ? filled : block;
+			if( n > count - filled )
+				n = count - filled;
+			memcpy( dest + filled, dest, n * sizeof( Type ) );
+			filled += n;
+		}
+	}
+};
+
+//-----------------------------------------------------------------------------
+
+//! SizeType is signed so that the range checks below mean something, and as
+//! wide as a pointer so that big images don't overflow it
+template< typename Type, typename SizeType = ptrdiff_t >
 class CSafeArray
 {
 public:
-	CSafeArray() : data( 0 ), _size( SizeType() ) { }
+	CSafeArray() : data( 0 ), _size( SizeType() ), myArena( NULL ) { }
 	CSafeArray( SizeType size ) : 
 		data( new Type[ size ] ),
-		_size( size )
+		_size( size ),
+		myArena( NULL )
 	{
-		
-		/*for( SizeType i = 0; i < Size(); ++i ) 
-			data[ i ] = Type();*/
-		
-		memset( data, (int)Type(), Size() * sizeof( Type ) );
+		Fill( Type() );
 	}
 	
 	CSafeArray( const CSafeArray& other ) :
 		data( 0 ), 
-		_size( SizeType() )
+		_size( SizeType() ),
+		myArena( NULL )
 	{
 		operator=(other);
 	}
 
+#if CENG_HAS_MOVE
+	CSafeArray( CSafeArray&& other ) :
+		data( other.data ),
+		_size( other._size ),
+		myArena( other.myArena )
+	{
+		other.data = 0;
+		other._size = SizeType();
+	}
+
+	CSafeArray& operator=( CSafeArray&& other )
+	{
+		if( this != &other )
+		{
+			// the elements come with the arena they are in, other is left
+			// empty with the arena it had
+			Clear();
+			data = other.data;
+			_size = other._size;
+			myArena = other.myArena;
+			other.data = 0;
+			other._size = SizeType();
+		}
+		return *this;
+	}
+#endif
+
 	~CSafeArray()
 	{
 		Clear();
@@ -43,20 +179,18 @@ public:
 
 	const CSafeArray& operator=( const CSafeArray& other )
 	{
+		if( this == &other )
+			return *this;
+
 		if( other._size != _size )
 		{
 			Clear();
-			data =  new Type[ other._size ];
+			data = NewElements( other._size );
 			_size = other._size;
 		}
 
-		
-		for( SizeType i = 0; i < Size(); ++i ) 
-			data[ i ] = other.Rand( i );
-		
-		// memcpy( data, other.data, Size() * sizeof( Type ) );
-		// fast_memcpy( data, other.data, Size() * sizeof( Type ) );
-		// X_aligned_memcpy_sse2( data, other.data, Size() * sizeof( Type ) );
+		// memcpy for the types that allow it
+		CArrayCopier< Type >::Copy( data, other.data, Size() );
 
 		return *this;
 	}
@@ -75,13 +209,44 @@ public:
 
 	void Clear()
 	{
-		delete [] data;
+		DeleteElements();
 		data = 0;
 		_size = 0;
 	}
 
+	//! takes the memory for the elements from arena instead of new[], NULL
+	//! goes back to new[]. Only for an empty array, and the array has to
+	//! be cleared (or gone) before the arena is reset. Moves and swaps take
+	//! the arena along with the elements, copies don't. A moved-from array
+	//! keeps its own arena
+	void SetArena( CArena* arena )
+	{
+		cassert( _size == 0 );
+		myArena = arena;
+	}
+
+	CArena* GetArena() const { return myArena; }
+
 	void clear() { Clear(); }
 
+	//! exchanges the buffers, nothing gets copied
+	void Swap( CSafeArray& other )
+	{
+		Type* t_data = data;
+		data = other.data;
+		other.data = t_data;
+
+		SizeType t_size = _size;
+		_size = other._size;
+		other._size = t_size;
+
+		CArena* t_arena = myArena;
+		myArena = other.myArena;
+		other.myArena = t_arena;
+	}
+
+	void swap( CSafeArray& other ) { Swap( other ); }
+
 	SizeType Size() const { return _size; }
 	SizeType size() const { return _size; }
 
@@ -92,21 +257,34 @@ public:
 	{
 		if( _size != s )
 		{
-			Clear();
-			data =  new Type[ s ];
-			_size = s;
-			
-			
-			for( SizeType i = 0; i < Size(); ++i ) 
-				data[ i ] = Type();
-			/*
-			memset( data, (int)Type(), Size() * sizeof( Type ) );
-			*/
+			ResizeUninitialized( s );
+			Fill( Type() );
 		}
 	}
 
 	void resize( SizeType s ) { Resize( s ); }
 
+	//! like Resize() but the elements of trivial types are left as they
+	//! come from new, for buffers that get filled or overwritten right away
+	void ResizeUninitialized( SizeType s )
+	{
+		if( _size != s )
+		{
+			Clear();
+			if( s > 0 )
+			{
+				data = NewElements( s );
+				_size = s;
+			}
+		}
+	}
+
+	//! sets every element to value, memset / block copies for trivial types
+	void Fill( const Type& value )
+	{
+		CArrayFiller< Type >::Fill( data, _size, value );
+	}
+
 	inline const Type& At( SizeType i ) const
 	{
 		if( i < 0 || i >= _size )
@@ -131,7 +309,34 @@ public:
 
 	Type* data;
 private:
+	// new Type[ count ], or the same from the arena
+	Type* NewElements( SizeType count )
+	{
+		if( myArena == NULL )
+			return new Type[ count ];
+
+		Type* result = (Type*)myArena->Allocate( count * sizeof( Type ) );
+		for( SizeType i = 0; i < count; ++i )
+			new( result + i ) Type;
+
+		return result;
+	}
+
+	// the memory itself stays in the arena until it's reset
+	void DeleteElements()
+	{
+		if( myArena == NULL )
+		{
+			delete [] data;
+			return;
+		}
+
+		for( SizeType i = 0; i < _size; ++i )
+			data[ i ].~Type();
+	}
+
 	SizeType _size;
+	CArena* myArena;
 };
 
 } // end o namespace ceng